@@ -55,6 +55,60 @@ int test_devmem_access() {
     return 0;
 }
 
+// The HLS miner's job registers: write the default (bare-nonce) job and
+// read it back. A bitstream built before the job was added reads back
+// something else, and would mine an unprogrammed job.
+#define REG_JOB_NONCE_OFF_OFFSET 0x80
+#define REG_JOB_STATE_OFFSET     0x100
+
+int test_job_registers() {
+    uint32_t words[50] = {0};
+    int fd, bad = 0;
+    void *map_base;
+    
+    printf("\n=== Testing miner job registers ===\n");
+    
+    words[1] = 0x00000006;      // lane 0 high word: padding after the nonce
+    words[33] = 0x80000000;     // lane 16 high word: last bit of the rate
+    
+    fd = open("/dev/mem", O_RDWR | O_SYNC);
+    if (fd == -1) {
+        printf("Failed to open /dev/mem: %s\n", strerror(errno));
+        return -1;
+    }
+    map_base = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                    TEST_ADDR & ~(PAGE_SIZE - 1));
+    if (map_base == MAP_FAILED) {
+        printf("✗ mmap failed: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    
+    volatile uint32_t *regs = (volatile uint32_t *)((char *)map_base + (TEST_ADDR & (PAGE_SIZE - 1)));
+    for (int i = 0; i < 50; i++) {
+        regs[REG_JOB_STATE_OFFSET / 4 + i] = words[i];
+    }
+    regs[REG_JOB_NONCE_OFF_OFFSET / 4] = 0;
+    for (int i = 0; i < 50; i++) {
+        if (regs[REG_JOB_STATE_OFFSET / 4 + i] != words[i]) {
+            bad++;
+        }
+    }
+    if (regs[REG_JOB_NONCE_OFF_OFFSET / 4] != 0) {
+        bad++;
+    }
+    
+    if (bad == 0) {
+        printf("✓ Job registers hold the default job\n");
+    } else {
+        printf("✗ %d job register words read back wrong; regenerate the RTL\n", bad);
+    }
+    
+    munmap(map_base, PAGE_SIZE);
+    close(fd);
+    return bad == 0 ? 0 : -1;
+}
+
 void check_system_info() {
     printf("\n=== System Information ===\n");
     
@@ -125,6 +179,7 @@ int main() {
     check_system_info();
     test_alternative_addresses();
     test_devmem_access();
+    test_job_registers();
     
     printf("\n=== Recommendations ===\n");
     printf("If mmap continues to fail:\n");
@@ -15,7 +15,9 @@
 
 #define MAX_COMPARE_COUNT 1000000  
 
-// Register offsets
+// Register offsets of the VHDL axi_miner (miner_control/axi_miner.vhd). It
+// hashes the bare nonce in fabric and has no job registers; the HLS core,
+// which takes a job, is driven by updated_miner.c and miner_dup.c.
 // Sending 
 #define REG_CTRL_READY    0x00 // Sent by PS to start mining/reset comparator
 #define REG_NONCE_START   0x04 // Only nonce is sent from PS to header
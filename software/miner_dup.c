@@ -19,6 +19,8 @@
 #define REG_RESULT_OFFSET      0x60  // control_result_nonce
 #define REG_HASH_COUNT_LOW_OFFSET  0x18  // control_hash_count_low
 #define REG_HASH_COUNT_HIGH_OFFSET 0x70  // control_hash_count_high
+#define REG_JOB_NONCE_OFF_OFFSET   0x80  // control_job_nonce_off
+#define REG_JOB_STATE_OFFSET       0x100 // control_job_state, 2 words a lane
 
 // +++ ADD +++
 #define REG_CTRL_OFFSET   0x00
@@ -84,6 +86,26 @@ void cleanup_miner_interface(int fd) {
 #define READ_REG(offset) (miner_regs[(offset)/4])
 #define WRITE_REG(offset, value) (miner_regs[(offset)/4] = (value))
 
+// Job the PL hashes each nonce into (mining_job_t in sha3_hls.h); lanes
+// low word first
+void write_mining_job(const uint64_t state[25], uint32_t nonce_off) {
+    for (int i = 0; i < 25; i++) {
+        WRITE_REG(REG_JOB_STATE_OFFSET + 8 * i, (uint32_t)state[i]);
+        WRITE_REG(REG_JOB_STATE_OFFSET + 8 * i + 4, (uint32_t)(state[i] >> 32));
+    }
+    WRITE_REG(REG_JOB_NONCE_OFF_OFFSET, nonce_off);
+}
+
+// Default job: the header is just the nonce, as mining_job_init(hdr, 4, 0)
+// builds it, so the PL hashes SHA3-256(nonce) as before
+void write_default_job() {
+    uint64_t state[25] = {0};
+
+    state[0] = 0x06ULL << 32;               // padding after the nonce
+    state[16] = 0x8000000000000000ULL;      // last bit of the rate
+    write_mining_job(state, 0);
+}
+
 void start_mining(uint32_t initial_nonce, uint32_t target) {
     if (!miner_regs) {
         printf("Error: Miner interface not initialized\n");
@@ -98,6 +120,7 @@ void start_mining(uint32_t initial_nonce, uint32_t target) {
     WRITE_REG(REG_STOP_OFFSET, 0);
 
     // +++ ADD +++ //
+    write_default_job();
     WRITE_REG(REG_NONCE_OFFSET,  initial_nonce);
     WRITE_REG(REG_TARGET_OFFSET, target);
 
@@ -22,6 +22,11 @@
 #define REG_HASH_COUNT_LOW_OFFSET  0x18
 #define REG_HASH_COUNT_HIGH_OFFSET 0x70
 
+// Mining job (pinned in sha3_miner_top): nonce offset, then 25 state
+// lanes as two 32-bit words each, low word first
+#define REG_JOB_NONCE_OFF_OFFSET 0x80
+#define REG_JOB_STATE_OFFSET     0x100
+
 // Mining timeout in seconds
 #define MINING_TIMEOUT_SECONDS 15
 
@@ -39,6 +44,26 @@ static void *map_base = NULL;
 // =======================
 // Miner control functions
 // =======================
+// Job the PL hashes each nonce into (mining_job_t in sha3_hls.h)
+void write_mining_job(const uint64_t state[25], uint32_t nonce_off) {
+    for (int i = 0; i < 25; i++) {
+        REG(REG_JOB_STATE_OFFSET + 8 * i) = (uint32_t)state[i];
+        REG(REG_JOB_STATE_OFFSET + 8 * i + 4) = (uint32_t)(state[i] >> 32);
+    }
+    REG(REG_JOB_NONCE_OFF_OFFSET) = nonce_off;
+}
+
+// Default job: the header is just the nonce, as mining_job_init(hdr, 4, 0)
+// builds it, so the PL hashes SHA3-256(nonce) as before. Padding 0x06
+// right after the nonce, 0x80 at the top of the last rate lane.
+void write_default_job() {
+    uint64_t state[25] = {0};
+
+    state[0] = 0x06ULL << 32;
+    state[16] = 0x8000000000000000ULL;
+    write_mining_job(state, 0);
+}
+
 void start_mining(uint32_t initial_nonce, uint32_t target) {
     printf("Starting mining: nonce=%u, target=%u\n", initial_nonce, target);
 
@@ -46,6 +71,7 @@ void start_mining(uint32_t initial_nonce, uint32_t target) {
     usleep(1000);
     REG(REG_STOP_OFFSET) = 0;
 
+    write_default_job();
     REG(REG_NONCE_OFFSET) = initial_nonce;
     REG(REG_TARGET_OFFSET) = target;
     REG(REG_START_OFFSET) = 1;
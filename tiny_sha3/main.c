@@ -2,9 +2,13 @@
 // 19-Nov-11  Markku-Juhani O. Saarinen <mjos@iki.fi>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
 #include "sha3.h"
+#include "sha3_dispatch.h"
 
 // read a hex string, return byte length or -1 on error.
 
@@ -154,9 +158,1358 @@ int test_shake()
     return fails;
 }
 
+// long and oddly split messages through the lane-granular sponge paths
+
+static int test_sponge_backend(const char *name)
+{
+    // SHA3-256 and SHAKE128 bytes 968..999 of 10007 bytes i % 251
+    const char *sha3_hex =
+        "9DAE8158018B848A80D207A09D215DE7BA81ABD4EC11C58285F71585BCCEDD22";
+    const char *shake_hex =
+        "8E60763D35643D16B805DC52786EE9729179EF87AD234B678EAA258D3FA35959";
+    const size_t split[] = { 1, 3, 7, 8, 13, 64, 135, 136, 137, 300 };
+
+    static uint8_t msg[10007], out[1000];
+    uint8_t ref[32], buf[32];
+    struct iovec iov[1500];
+    sha3_ctx_t ctx;
+    size_t i, n;
+    int fails, k;
+
+    fails = 0;
+    for (i = 0; i < sizeof(msg); i++)
+        msg[i] = i % 251;
+
+    test_readhex(ref, sha3_hex, sizeof(ref));
+    sha3(msg, sizeof(msg), buf, 32);
+    if (memcmp(buf, ref, 32) != 0) {
+        fprintf(stderr, "SHA3-256, len %d test FAILED (%s).\n",
+            (int) sizeof(msg), name);
+        fails++;
+    }
+
+    // same digest with the input and offsets misaligned every which way
+    sha3_init(&ctx, 32);
+    for (i = 0, n = 0; i < sizeof(msg); i += n) {
+        n = split[i % 10];
+        if (n > sizeof(msg) - i)
+            n = sizeof(msg) - i;
+        sha3_update(&ctx, msg + i, n);
+    }
+    sha3_final(buf, &ctx);
+    if (memcmp(buf, ref, 32) != 0) {
+        fprintf(stderr, "SHA3-256 split update test FAILED (%s).\n", name);
+        fails++;
+    }
+
+    // and gathered from pieces, some empty
+    for (i = 0, n = 0, k = 0; i < sizeof(msg); i += n, k++) {
+        n = split[(i + k) % 10] - (k % 7 == 0);
+        if (n > sizeof(msg) - i)
+            n = sizeof(msg) - i;
+        iov[k].iov_base = msg + i;
+        iov[k].iov_len = n;
+    }
+    sha3_init(&ctx, 32);
+    sha3_updatev(&ctx, iov, k);
+    sha3_final(buf, &ctx);
+    if (memcmp(buf, ref, 32) != 0) {
+        fprintf(stderr, "SHA3-256 gather update test FAILED (%s).\n", name);
+        fails++;
+    }
+
+    test_readhex(ref, shake_hex, sizeof(ref));
+    shake128_init(&ctx);
+    shake_update(&ctx, msg, sizeof(msg));
+    shake_xof(&ctx);
+    for (i = 0, n = 0; i < sizeof(out); i += n) {
+        n = split[(i + 3) % 10];
+        if (n > sizeof(out) - i)
+            n = sizeof(out) - i;
+        shake_out(&ctx, out + i, n);
+    }
+    if (memcmp(out + 968, ref, 32) != 0) {
+        fprintf(stderr, "SHAKE128 split output test FAILED (%s).\n", name);
+        fails++;
+    }
+
+    // all of it in one call, against a byte at a time
+    shake128_init(&ctx);
+    shake_update(&ctx, msg, sizeof(msg));
+    shake_xof(&ctx);
+    shake_out(&ctx, out, sizeof(out));
+    shake128_init(&ctx);
+    shake_update(&ctx, msg, sizeof(msg));
+    shake_xof(&ctx);
+    for (i = 0; i < sizeof(out); i++) {
+        shake_out(&ctx, buf, 1);
+        if (buf[0] != out[i])
+            break;
+    }
+    if (i < sizeof(out)) {
+        fprintf(stderr, "SHAKE128 block output test FAILED (%s).\n", name);
+        fails++;
+    }
+
+    return fails;
+}
+
+// on every scalar backend: bi32 absorbs and squeezes runs of whole blocks
+// on its interleaved state
+
+int test_sponge()
+{
+    const char *scalar[] = { "ref", "unrolled", "bi32" };
+    char saved[32];
+    int fails;
+    size_t b;
+
+    fails = 0;
+    strcpy(saved, sha3_backend_name());
+    for (b = 0; b < sizeof(scalar) / sizeof(scalar[0]); b++) {
+        sha3_backend_select(scalar[b]);
+        fails += test_sponge_backend(scalar[b]);
+    }
+    sha3_backend_select(saved);
+
+    return fails;
+}
+
+// parallel SHAKE squeeze and the PRNG streams against shake_out()
+
+int test_xof()
+{
+    static uint8_t out[SHA3_MAX_WAYS][1000], ref[3000];
+    static sha3_prng_t g, h;
+    sha3_ctx_t c[SHA3_MAX_WAYS], r;
+    sha3_ctx_t *cp[SHA3_MAX_WAYS];
+    void *op[SHA3_MAX_WAYS];
+    uint8_t seed[5] = { 1, 2, 3, 4, 5 }, b;
+    size_t i, n;
+    int k, w, fails;
+
+    fails = 0;
+    for (k = 0; k < SHA3_MAX_WAYS; k++)
+        cp[k] = &c[k];
+
+    // 3 and 5 SHAKE256 streams (4- and 8-way), from an unaligned position
+    for (w = 3; w <= 5; w += 2) {
+        for (k = 0; k < w; k++) {
+            b = k;
+            shake256_init(&c[k]);
+            shake_update(&c[k], &b, 1);
+            shake_xof(&c[k]);
+            shake_out(&c[k], out[k], 10);
+            op[k] = out[k] + 10;
+        }
+        shake_out_multi(cp, op, w, 500);
+        for (k = 0; k < w; k++)
+            op[k] = out[k] + 510;
+        shake_out_multi(cp, op, w, 7);
+        for (k = 0; k < w; k++) {
+            shake_out(&c[k], out[k] + 517, 100);
+            b = k;
+            shake256_init(&r);
+            shake_update(&r, &b, 1);
+            shake_xof(&r);
+            shake_out(&r, ref, 617);
+            if (memcmp(out[k], ref, 617) != 0) {
+                fprintf(stderr, "[%d] SHAKE256 %d-stream test FAILED.\n",
+                    k, w);
+                fails++;
+            }
+        }
+    }
+
+    // PRNG output round = rate block of each stream in turn, however the
+    // output is split between fill() calls
+    sha3_prng_init(&g, seed, sizeof(seed));
+    for (i = 0, n = 0; i < 2 * sizeof(g.buf); i += n) {
+        n = (i * 7 + 1) % 300;
+        if (n > 2 * sizeof(g.buf) - i)
+            n = 2 * sizeof(g.buf) - i;
+        sha3_prng_fill(&g, ref + i, n);
+    }
+    for (k = 0; k < SHA3_MAX_WAYS; k++) {
+        b = k;
+        shake128_init(&r);
+        shake_update(&r, seed, sizeof(seed));
+        shake_update(&r, &b, 1);
+        shake_xof(&r);
+        shake_out(&r, out[k], 2 * 168);
+        if (memcmp(ref + 168 * k, out[k], 168) != 0 ||
+            memcmp(ref + sizeof(g.buf) + 168 * k, out[k] + 168, 168) != 0) {
+            fprintf(stderr, "[%d] PRNG stream test FAILED.\n", k);
+            fails++;
+        }
+    }
+
+    // forks are reproducible
+    sha3_prng_init(&g, seed, sizeof(seed));
+    sha3_prng_fork(&h, &g);
+    sha3_prng_fill(&h, out[0], 100);
+    sha3_prng_init(&g, seed, sizeof(seed));
+    sha3_prng_fork(&h, &g);
+    sha3_prng_fill(&h, out[1], 100);
+    sha3_prng_fill(&g, out[2], 100);
+    if (memcmp(out[0], out[1], 100) != 0 || memcmp(out[0], out[2], 100) == 0) {
+        fprintf(stderr, "PRNG fork test FAILED.\n");
+        fails++;
+    }
+
+    return fails;
+}
+
+// KangarooTwelve, RFC 9861 KT128 vectors; ptn(n) is n bytes i % 251
+
+int test_k12()
+{
+    const struct {
+        size_t mlen, clen;              // ptn(mlen) or 0xFF * mlen
+        int ff;
+        size_t outlen;                  // the last 32 bytes are checked
+        const char *hex;
+    } testvec[] = {
+        { 0, 0, 0, 32,
+        "1AC2D450FC3B4205D19DA7BFCA1B37513C0803577AC7167F06FE2CE1F0EF39E5" },
+        { 0, 0, 0, 64,
+        "4269C056B8C82E48276038B6D292966CC07A3D4645272E31FF38508139EB0A71" },
+        { 0, 0, 0, 10032,
+        "E8DC563642F7228C84684C898405D3A834799158C079B12880277A1D28E2FF6D" },
+        { 1, 0, 0, 32,
+        "2BDA92450E8B147F8A7CB629E784A058EFCA7CF7D8218E02D345DFAA65244A1F" },
+        { 17, 0, 0, 32,
+        "6BF75FA2239198DB4772E36478F8E19B0F371205F6A9A93A273F51DF37122888" },
+        { 289, 0, 0, 32,
+        "0C315EBCDEDBF61426DE7DCF8FB725D1E74675D7F5327A5067F367B108ECB67C" },
+        { 4913, 0, 0, 32,
+        "CB552E2EC77D9910701D578B457DDF772C12E322E4EE7FE417F92C758F0D59D0" },
+        { 83521, 0, 0, 32,
+        "8701045E22205345FF4DDA05555CBB5C3AF1A771C2B89BAEF37DB43D9998B9FE" },
+        { 1419857, 0, 0, 32,
+        "844D610933B1B9963CBDEB5AE3B6B05CC7CBD67CEEDF883EB678A0A8E0371682" },
+        { 0, 1, 1, 32,
+        "FAB658DB63E94A246188BF7AF69A133045F46EE984C56E3C3328CAAF1AA1A583" },
+        { 1, 41, 1, 32,
+        "D848C5068CED736F4462159B9867FD4C20B808ACC3D5BC48E0B06BA0A3762EC4" },
+        { 3, 1681, 1, 32,
+        "C389E5009AE57120854C2E8C64670AC01358CF4C1BAF89447A724234DC7CED74" },
+        { 7, 68921, 1, 32,
+        "75D2F86A2E644566726B4FBCFC5657B9DBCF070C7B0DCA06450AB291D7443BCF" },
+        { 8191, 0, 0, 32,
+        "1B577636F723643E990CC7D6A659837436FD6A103626600EB8301CD1DBE553D6" },
+        { 8192, 0, 0, 32,
+        "48F256F6772F9EDFB6A8B661EC92DC93B95EBD05A08A17B39AE3490870C926C3" },
+        { 8192, 8189, 0, 32,
+        "3ED12F70FB05DDB58689510AB3E4D23C6C6033849AA01E1D8C220A297FEDCD0B" },
+        { 8192, 8190, 0, 32,
+        "6A7C1B6A5CD0D8C9CA943A4A216CC64604559A2EA45F78570A15253D67BA00AE" }
+    };
+
+    static uint8_t msg[1419857], cust[68921], ffs[7], out[10032];
+    uint8_t ref[32];
+    size_t i, n;
+    int t, fails;
+
+    fails = 0;
+    for (i = 0; i < sizeof(msg); i++)
+        msg[i] = i % 251;
+    for (i = 0; i < sizeof(cust); i++)
+        cust[i] = i % 251;
+    memset(ffs, 0xFF, sizeof(ffs));
+
+    for (i = 0; i < sizeof(testvec) / sizeof(testvec[0]); i++) {
+        n = testvec[i].outlen;
+        test_readhex(ref, testvec[i].hex, sizeof(ref));
+        for (t = 1; t <= 4; t += 3) {   // 1 and 4 threads
+            memset(out, 0, n);
+            kangarootwelve(testvec[i].ff ? ffs : msg, testvec[i].mlen,
+                cust, testvec[i].clen, out, n, t);
+            if (memcmp(out + n - 32, ref, 32) != 0) {
+                fprintf(stderr, "[%d] KT128 %d-thread test FAILED.\n",
+                    (int) i, t);
+                fails++;
+            }
+        }
+    }
+
+    return fails;
+}
+
+// SP 800-185 functions; ptn(n) is n bytes i % 251
+
+int test_sp800185()
+{
+    const char *hex[] = {
+        // 0: ParallelHash128, SP 800-185 sample #1
+        "BA8DC1D1D979331D3F813603C67F72609AB5E44B94A0B8F9AF46514454A2B4F5",
+        // 1: cSHAKE128(ptn(200), N = ptn(3), S = ptn(5))
+        "8D6156209CD38E66F6B48BC8DF8DEA7B6C990C232EAB49A1DB79019B0A86DD72",
+        // 2: cSHAKE256(ptn(1000), N = "", S = ptn(300)), bytes 32..63
+        "BA82B5496AB21F7B14AB14D383A11A26F744F2E1E5BD633769A3D7A7F9CD374F",
+        // 3: KMAC128(K = ptn(32), ptn(200), 256, S = ptn(5))
+        "044D0D371066EAE7F7BB6D305B6CB67A4F0D269EEB98088891453419E191936A",
+        // 4: KMAC256(K = ptn(200), ptn(300), 512, S = ""), bytes 32..63
+        "B7B7E5C5571A45FA21093DDA203AA428B705BFC50757F1B85106433FA94D9B3C",
+        // 5: KMACXOF128(K = ptn(32), ptn(200), S = ptn(5))
+        "F33D7AC3E5E1E3048D10DB160CBD937891C922925546D1FE47681698DDF9CE78",
+        // 6: TupleHash128((ptn(3), "", ptn(200)), 256, S = ptn(5))
+        "4B2F2F2FFFB215EB57A0A6B2DEB8F8D6BDB076AB956F0D23E484D364E1727934",
+        // 7: TupleHash256((ptn(300)), 512, S = ""), bytes 32..63
+        "18391B525A763F83E859FCFD3203A1F52132823EF169C83092BE3144BB013FB9",
+        // 8: TupleHashXOF128((ptn(3), "", ptn(200)), S = ptn(5))
+        "3626CD7D980A851D72F7F5832C1920059D4C290D564452906FC88B01C55666ED",
+        // 9: ParallelHash128(ptn(100000), B = 8192, 256, S = ptn(5))
+        "1F98A3DE32FEFC9CB9EB85A1BBC1127B5831435955AD1F02E9061A4AFAF910D0",
+        // 10: ParallelHash256(ptn(5000), B = 100, 512, S = ""), bytes 32..63
+        "6B4B9A10FB9C8E678A626DEFF627890E9DBF2D1ACEBB63588079DC52C0CA559A",
+        // 11: ParallelHashXOF128(ptn(100000), B = 8192, S = ptn(5))
+        "A603CC6656B7138A1504FDE47D961F5A0F41E181A69AA5E809380F89F013648E"
+    };
+    const uint8_t x1[24] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+        0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27
+    };
+    static uint8_t ptn[100000];
+    uint8_t out[12][64], ref[32];
+    sha3_ctx_t c;
+    size_t i;
+    int t, fails;
+
+    for (i = 0; i < sizeof(ptn); i++)
+        ptn[i] = i % 251;
+
+    parallelhash(128, x1, sizeof(x1), 8, "", 0, out[0], 32, 0, 1);
+
+    cshake_init(&c, 128, ptn, 3, ptn, 5);
+    sha3_update(&c, ptn, 200);
+    cshake_xof(&c);
+    shake_out(&c, out[1], 32);
+
+    cshake_init(&c, 256, "", 0, ptn, 300);
+    sha3_update(&c, ptn, 1000);
+    cshake_xof(&c);
+    shake_out(&c, out[2], 64);
+
+    kmac_init(&c, 128, ptn, 32, ptn, 5);
+    sha3_update(&c, ptn, 200);
+    kmac_final(&c, out[3], 32);
+
+    kmac_init(&c, 256, ptn, 200, "", 0);
+    sha3_update(&c, ptn, 300);
+    kmac_final(&c, out[4], 64);
+
+    kmac_init(&c, 128, ptn, 32, ptn, 5);
+    sha3_update(&c, ptn, 200);
+    kmac_xof(&c);
+    shake_out(&c, out[5], 32);
+
+    tuplehash_init(&c, 128, ptn, 5);
+    tuplehash_add(&c, ptn, 3);
+    tuplehash_add(&c, ptn, 0);
+    tuplehash_add(&c, ptn, 200);
+    tuplehash_final(&c, out[6], 32);
+
+    tuplehash_init(&c, 256, "", 0);
+    tuplehash_add(&c, ptn, 300);
+    tuplehash_final(&c, out[7], 64);
+
+    tuplehash_init(&c, 128, ptn, 5);
+    tuplehash_add(&c, ptn, 3);
+    tuplehash_add(&c, ptn, 0);
+    tuplehash_add(&c, ptn, 200);
+    tuplehash_xof(&c);
+    shake_out(&c, out[8], 32);
+
+    fails = 0;
+    for (t = 1; t <= 4; t += 3) {           // 1 and 4 threads
+        parallelhash(128, ptn, 100000, 8192, ptn, 5, out[9], 32, 0, t);
+        parallelhash(256, ptn, 5000, 100, "", 0, out[10], 64, 0, t);
+        parallelhash(128, ptn, 100000, 8192, ptn, 5, out[11], 32, 1, t);
+
+        for (i = 0; i < 12; i++) {
+            test_readhex(ref, hex[i], sizeof(ref));
+            if (memcmp(out[i] + (i == 2 || i == 4 || i == 7 || i == 10 ?
+                32 : 0), ref, 32) != 0) {
+                fprintf(stderr, "[%d] SP 800-185 test FAILED.\n", (int) i);
+                fails++;
+            }
+        }
+    }
+
+    // cSHAKE128(X, L, "", "") is SHAKE128(X, L)
+    cshake_init(&c, 128, "", 0, "", 0);
+    sha3_update(&c, ptn, 200);
+    cshake_xof(&c);
+    shake_out(&c, out[0], 64);
+    shake128_init(&c);
+    sha3_update(&c, ptn, 200);
+    shake_xof(&c);
+    shake_out(&c, out[1], 64);
+    if (memcmp(out[0], out[1], 64) != 0) {
+        fprintf(stderr, "cSHAKE128 with empty N and S test FAILED.\n");
+        fails++;
+    }
+
+    // every init sets the domain byte its final or xof pads with
+    sha3_init(&c, 32);
+    i = c.dsbyte == 0x06;
+    shake256_init(&c);
+    i &= c.dsbyte == 0x1F;
+    turboshake128_init(&c);
+    i &= c.dsbyte == 0x1F;
+    cshake_init(&c, 256, "", 0, "", 0);
+    i &= c.dsbyte == 0x1F;
+    cshake_init(&c, 256, "N", 1, "", 0);
+    i &= c.dsbyte == 0x04;
+    if (!i) {
+        fprintf(stderr, "Context domain byte test FAILED.\n");
+        fails++;
+    }
+
+    return fails;
+}
+
+// multi-buffer hashing of mixed lengths against sha3()
+
+int test_batch()
+{
+    const int mdlen[4] = { 28, 32, 48, 64 };
+    static uint8_t msg[1000], md[37][64];
+    uint8_t ref[64];
+    sha3_job_t job[37];
+    int i, m, n, fails;
+
+    fails = 0;
+    for (i = 0; i < (int) sizeof(msg); i++)
+        msg[i] = (i * 7) ^ (i >> 3);
+
+    for (m = 0; m < 4; m++) {
+        for (n = 1; n <= 37; n += 36) {         // single and batched
+            for (i = 0; i < n; i++) {
+                job[i].in = msg + i;
+                job[i].inlen = (i * 97 + m * 13) % 700;
+                job[i].md = md[i];
+            }
+            sha3_batch(job, n, mdlen[m]);
+            for (i = 0; i < n; i++) {
+                sha3(job[i].in, job[i].inlen, ref, mdlen[m]);
+                if (memcmp(md[i], ref, mdlen[m]) != 0) {
+                    fprintf(stderr, "[%d] SHA3-%d batch, len %d test FAILED.\n",
+                        i, mdlen[m] * 8, (int) job[i].inlen);
+                    fails++;
+                }
+            }
+        }
+    }
+
+    return fails;
+}
+
+// fixed-length SHA3-256 entry points against sha3()
+
+int test_fixed()
+{
+    static uint8_t msg[19 * 64], md[19 * 32];
+    uint8_t ref[32];
+    int i, n, w, fails;
+
+    fails = 0;
+    for (i = 0; i < (int) sizeof(msg); i++)
+        msg[i] = (i * 29) ^ (i >> 4);
+
+    for (w = 32; w <= 64; w += 32) {
+        if (w == 32)
+            sha3_256_32B(md, msg);
+        else
+            sha3_256_64B(md, msg);
+        sha3(msg, w, ref, 32);
+        if (memcmp(md, ref, 32) != 0) {
+            fprintf(stderr, "SHA3-256 fixed %d-byte test FAILED.\n", w);
+            fails++;
+        }
+
+        for (n = 1; n <= 19; n += 9) {
+            memset(md, 0, sizeof(md));
+            if (w == 32)
+                sha3_256_32B_batch(md, msg, n);
+            else
+                sha3_256_64B_batch(md, msg, n);
+            for (i = 0; i < n; i++) {
+                sha3(msg + w * i, w, ref, 32);
+                if (memcmp(md + 32 * i, ref, 32) != 0) {
+                    fprintf(stderr, "[%d] SHA3-256 fixed %d-byte batch of %d "
+                        "test FAILED.\n", i, w, n);
+                    fails++;
+                }
+            }
+        }
+    }
+
+    return fails;
+}
+
+// hash chains against repeated sha3(), on each scalar backend and
+// instruction set level
+
+int test_chain()
+{
+    const char *spec[3] = { "ref,generic", "unrolled,avx2", "bi32,avx512" };
+    const uint64_t steps[4] = { 0, 1, 2, 1000 };
+    static uint8_t in[11 * 32], md[11 * 32], ref[11 * 32];
+    char saved[32];
+    uint64_t j;
+    int b, i, k, n, fails;
+
+    fails = 0;
+    for (i = 0; i < (int) sizeof(in); i++)
+        in[i] = i * 3 + 1;
+
+    strcpy(saved, sha3_backend_name());
+    for (b = 0; b < 3; b++) {
+        sha3_backend_select(spec[b]);
+        for (i = 0; i < 4; i++) {
+            memcpy(ref, in, sizeof(ref));
+            for (k = 0; k < 11; k++) {
+                for (j = 0; j < steps[i]; j++)
+                    sha3(ref + 32 * k, 32, ref + 32 * k, 32);
+            }
+
+            sha3_256_chain(md, in, steps[i]);
+            if (memcmp(md, ref, 32) != 0) {
+                fprintf(stderr, "SHA3-256 chain of %d test FAILED (%s).\n",
+                    (int) steps[i], sha3_backend_name());
+                fails++;
+            }
+            for (n = 1; n <= 11; n += 5) {
+                sha3_256_chain_batch(md, in, n, steps[i]);
+                if (memcmp(md, ref, 32 * n) != 0) {
+                    fprintf(stderr, "SHA3-256 %d chains of %d test FAILED "
+                        "(%s).\n", n, (int) steps[i], sha3_backend_name());
+                    fails++;
+                }
+            }
+        }
+    }
+    sha3_backend_select(saved);
+
+    return fails;
+}
+
+// shared-prefix hashing: context snapshots and sha3_batch_suffix()
+
+int test_midstate()
+{
+    const int pfx[5] = { 0, 5, 136, 200, 301 };
+    static uint8_t msg[1200], md[21][32];
+    uint8_t ref[32], cln[32];
+    sha3_ctx_t mid, snap, c;
+    sha3_job_t job[21];
+    int i, m, n, fails;
+
+    fails = 0;
+    for (i = 0; i < (int) sizeof(msg); i++)
+        msg[i] = (i * 13) ^ (i >> 2);
+
+    for (m = 0; m < 5; m++) {
+        sha3_init(&mid, 32);
+        sha3_update(&mid, msg, pfx[m]);
+
+        // snapshot survives updates to the original and restores it
+        sha3_ctx_snapshot(&snap, &mid);
+        sha3_update(&mid, msg, 77);
+        sha3_ctx_restore(&mid, &snap);
+
+        for (n = 1; n <= 21; n += 20) {
+            for (i = 0; i < n; i++) {
+                job[i].in = msg + pfx[m];
+                job[i].inlen = (i * 61 + m) % 400;
+                job[i].md = md[i];
+            }
+            sha3_batch_suffix(&mid, job, n);
+            for (i = 0; i < n; i++) {
+                sha3(msg, pfx[m] + job[i].inlen, ref, 32);
+                sha3_ctx_clone(&c, &mid);
+                sha3_update(&c, job[i].in, job[i].inlen);
+                sha3_final(cln, &c);
+                if (memcmp(md[i], ref, 32) != 0 ||
+                    memcmp(cln, ref, 32) != 0) {
+                    fprintf(stderr, "[%d] SHA3-256 prefix %d, suffix %d "
+                        "test FAILED.\n", i, pfx[m], (int) job[i].inlen);
+                    fails++;
+                }
+            }
+        }
+    }
+
+    return fails;
+}
+
+// overlapped file hashing: files around the buffer size and a pipe
+
+int test_stream()
+{
+    const size_t len[5] = { 0, 1, 1 << 20, (3 << 20) + 1234, (9 << 20) + 7 };
+    static uint8_t buf[(9 << 20) + 7];
+    char path[] = "/tmp/sha3testXXXXXX";
+    uint8_t md[32], ref[32];
+    sha3_stream_stats_t st;
+    sha3_ctx_t c;
+    size_t i;
+    int fd, p[2], f, k, fails;
+
+    fails = 0;
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = (i * 7) ^ (i >> 11);
+
+    if ((fd = mkstemp(path)) < 0) {
+        fprintf(stderr, "SHA3 stream test: no temporary file.\n");
+        return 1;
+    }
+    for (k = 0; k < 5; k++) {
+        if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0 ||
+            write(fd, buf, len[k]) != (ssize_t) len[k]) {
+            fprintf(stderr, "SHA3 stream test: write failed.\n");
+            fails++;
+            break;
+        }
+        sha3(buf, len[k], ref, 32);
+        for (f = 0; f <= SHA3_STREAM_DIRECT; f++) {
+            memset(md, 0, sizeof(md));
+            if (sha3_stream_file(path, md, 32, f, &st) == 0 ||
+                memcmp(md, ref, 32) != 0 || st.bytes != len[k]) {
+                fprintf(stderr, "SHA3-256 stream of %d bytes test FAILED "
+                    "(flags %d).\n", (int) len[k], f);
+                fails++;
+            }
+        }
+    }
+    close(fd);
+    unlink(path);
+
+    // a pipe, filled before it is read
+    if (pipe(p) == 0) {
+        if (write(p[1], buf, 5000) != 5000)
+            fails++;
+        close(p[1]);
+        sha3_init(&c, 32);
+        if (sha3_stream_update(&c, p[0], NULL) == 0)
+            fails++;
+        sha3_final(md, &c);
+        close(p[0]);
+        sha3(buf, 5000, ref, 32);
+        if (memcmp(md, ref, 32) != 0) {
+            fprintf(stderr, "SHA3-256 stream of a pipe test FAILED.\n");
+            fails++;
+        }
+    }
+
+    return fails;
+}
+
+// Merkle tree: a small tree by hand, then edits rehashed through the
+// cache against full rebuilds
+
+static void test_merkle_leaf(uint8_t *md, const uint8_t *in, size_t len)
+{
+    sha3_ctx_t c;
+
+    sha3_init(&c, 32);
+    sha3_update(&c, "", 1);                 // tag 0x00
+    sha3_update(&c, in, len);
+    sha3_final(md, &c);
+}
+
+static void test_merkle_node(uint8_t *md, const uint8_t *l, const uint8_t *r)
+{
+    uint8_t buf[65];
+
+    buf[0] = 0x01;
+    memcpy(buf + 1, l, 32);
+    memcpy(buf + 33, r, 32);
+    sha3(buf, 65, md, 32);
+}
+
+// the top node of a whole tree, level by level; a lone node moves up
+
+static void test_merkle_top(uint8_t *md, const uint8_t *in, size_t len,
+    size_t chunk)
+{
+    static uint8_t h[128][32];
+    size_t i, w;
+
+    for (w = 0; w * chunk < len; w++)
+        test_merkle_leaf(h[w], in + w * chunk,
+            len - w * chunk < chunk ? len - w * chunk : chunk);
+    for (; w > 1; w = (w + 1) / 2) {
+        for (i = 0; i < w / 2; i++)
+            test_merkle_node(h[i], h[2 * i], h[2 * i + 1]);
+        if (w & 1)
+            memcpy(h[w / 2], h[w - 1], 32);
+    }
+    memcpy(md, h[0], 32);
+}
+
+int test_merkle()
+{
+    const int edit[4][2] = { { 0, 1 }, { 4095, 2 }, { 70000, 9000 },
+        { 299990, 10 } };
+    static uint8_t buf[300000];
+    char path[] = "/tmp/sha3testXXXXXX", cache[40];
+    uint8_t md[32], ref[32], h[5][32], len[16];
+    sha3_merkle_t t;
+    sha3_ctx_t c;
+    int fd, i, k, fails;
+
+    fails = 0;
+    for (i = 0; i < (int) sizeof(buf); i++)
+        buf[i] = (i * 11) ^ (i >> 9);
+    if ((fd = mkstemp(path)) < 0) {
+        fprintf(stderr, "SHA3 Merkle test: no temporary file.\n");
+        return 1;
+    }
+    snprintf(cache, sizeof(cache), "%s.mt", path);
+
+    // 10000 bytes in 4 KiB leaves: root over ((l0 l1) l2)
+    if (write(fd, buf, 10000) != 10000 ||
+        !sha3_merkle_open(&t, path, NULL, 4096, 1)) {
+        fprintf(stderr, "SHA3 Merkle test: setup failed.\n");
+        close(fd);
+        unlink(path);
+        return 1;
+    }
+    sha3_merkle_root(&t, md);
+    sha3_merkle_close(&t);
+    test_merkle_leaf(h[0], buf, 4096);
+    test_merkle_leaf(h[1], buf + 4096, 4096);
+    test_merkle_leaf(h[2], buf + 8192, 10000 - 8192);
+    test_merkle_node(h[3], h[0], h[1]);
+    test_merkle_node(h[4], h[3], h[2]);
+    memset(len, 0, sizeof(len));
+    len[0] = 10000 & 0xFF;
+    len[1] = 10000 >> 8;
+    len[9] = 4096 >> 8;
+    sha3_init(&c, 32);
+    sha3_update(&c, h[4], 32);
+    sha3_update(&c, len, 16);
+    sha3_final(ref, &c);
+    if (memcmp(md, ref, 32) != 0) {
+        fprintf(stderr, "SHA3-256 Merkle root test FAILED.\n");
+        fails++;
+    }
+
+    // edits marked dirty, each time through a reopened cache
+    if (pwrite(fd, buf, sizeof(buf), 0) != sizeof(buf))
+        fails++;
+    unlink(cache);
+    sha3_merkle_open(&t, path, cache, 4096, 0);
+    sha3_merkle_root(&t, md);
+    sha3_merkle_close(&t);
+    for (k = 0; k < 4; k++) {
+        for (i = 0; i < edit[k][1]; i++)
+            buf[edit[k][0] + i] ^= 0x5A;
+        if (pwrite(fd, buf + edit[k][0], edit[k][1], edit[k][0]) !=
+            edit[k][1])
+            fails++;
+
+        sha3_merkle_open(&t, path, cache, 4096, 0);
+        sha3_merkle_dirty(&t, edit[k][0], edit[k][1]);
+        if (!sha3_merkle_root(&t, md))
+            fails++;
+        sha3_merkle_close(&t);
+        sha3_merkle_open(&t, path, NULL, 4096, 0);
+        sha3_merkle_root(&t, ref);
+        sha3_merkle_close(&t);
+        if (memcmp(md, ref, 32) != 0) {
+            fprintf(stderr, "SHA3-256 Merkle edit at %d test FAILED.\n",
+                edit[k][0]);
+            fails++;
+        }
+    }
+
+    // the last tree against one built by hand
+    test_merkle_top(h[4], buf, sizeof(buf), 4096);
+    memset(len, 0, sizeof(len));
+    memcpy(len, "\xE0\x93\x04", 3);          // 300000
+    len[9] = 4096 >> 8;
+    sha3_init(&c, 32);
+    sha3_update(&c, h[4], 32);
+    sha3_update(&c, len, 16);
+    sha3_final(md, &c);
+    if (memcmp(md, ref, 32) != 0) {
+        fprintf(stderr, "SHA3-256 Merkle 74-leaf root test FAILED.\n");
+        fails++;
+    }
+
+    // a clean reopen hashes nothing and agrees
+    sha3_merkle_open(&t, path, cache, 4096, 0);
+    if (t.ndirty != 0)
+        fails++;
+    sha3_merkle_root(&t, md);
+    sha3_merkle_close(&t);
+    if (memcmp(md, ref, 32) != 0) {
+        fprintf(stderr, "SHA3-256 Merkle cached root test FAILED.\n");
+        fails++;
+    }
+
+    close(fd);
+    unlink(path);
+    unlink(cache);
+
+    return fails;
+}
+
+// nonce search: hash_nonce() values against sha3(), the batched forms
+// against it, kernels from round-1 midstates of other blocks, searches on
+// one and several threads, an empty one, and one across the 2^32 wrap
+
+int test_mine()
+{
+    const char *spec[3] = { "generic", "avx2", "avx512" };
+    const int off[5] = { 0, 3, 5, 12, 132 };
+    const uint32_t target = 0x00200000;
+    uint8_t buf[4], md[32];
+    sha3_mine_stats_t st;
+    sha3_mine_r1_t r1;
+    uint32_t x, h, nonce, first, m, m8, hv[16 + 64];
+    uint64_t m64, blk[25], ref[25];
+    char saved[32];
+    int b, i, k, th, fails;
+
+    fails = 0;
+    first = 0;
+    for (i = 0; i < 5000; i++) {
+        x = i < 4000 ? (uint32_t) i : 0x9E3779B9 * (uint32_t) i;
+        buf[0] = (uint8_t) x;
+        buf[1] = (uint8_t) (x >> 8);
+        buf[2] = (uint8_t) (x >> 16);
+        buf[3] = (uint8_t) (x >> 24);
+        sha3(buf, 4, md, 32);
+        h = md[0] | md[1] << 8 | md[2] << 16 | (uint32_t) md[3] << 24;
+        if (sha3_mine_hash(x) != h) {
+            fprintf(stderr, "hash_nonce(%08X) test FAILED.\n", x);
+            fails++;
+        }
+        if (first == 0 && h < target)
+            first = x;
+    }
+
+    // batched forms on every kernel level, against the scalar hash
+    strcpy(saved, sha3_backend_name());
+    for (b = 0; b < 3; b++) {
+        sha3_backend_select(spec[b]);
+        for (i = 0; i < 4; i++) {
+            x = i < 2 ? 600u + 64u * i : 0xFFFFFFE0u + 7u * i;
+            sha3_mine_hash_x4(x, target << i, &m, hv);
+            sha3_mine_hash_x8(x, target << i, &m8, hv + 8);
+            sha3_mine_hash_x64(x, target << i, &m64, hv + 16);
+            for (k = 0; k < 64; k++) {
+                h = sha3_mine_hash(x + k);
+                if ((k < 4 && (hv[k] != h ||
+                    ((m >> k) & 1) != (h < target << i))) ||
+                    (k < 8 && (hv[8 + k] != h ||
+                    ((m8 >> k) & 1) != (h < target << i))) ||
+                    hv[16 + k] != h ||
+                    ((m64 >> k) & 1) != (h < target << i)) {
+                    fprintf(stderr, "hash_nonce_xN(%08X + %d) test FAILED "
+                        "(%s).\n", x, k, sha3_backend_name());
+                    fails++;
+                    break;
+                }
+            }
+        }
+    }
+    sha3_backend_select(saved);
+
+    // round-1 midstates of other blocks, the nonce at any byte offset
+    for (i = 0; i < 25; i++)
+        blk[i] = i < 17 ? 0x9E3779B97F4A7C15 * (i + 1) : 0;
+    for (b = 0; b < 5; b++) {
+        k = off[b];
+        for (i = 0; i < 4; i++)             // nonce bytes zero
+            blk[(k + i) / 8] &= ~((uint64_t) 0xFF << (8 * ((k + i) % 8)));
+        sha3_mine_r1_init(&r1, blk, k);
+        m = sha3_impl.mine4(&r1, 0x01020304 * b, 0x40000000, hv);
+        m8 = sha3_impl.mine8(&r1, 0x01020304 * b, 0x40000000, hv + 8);
+        for (i = 0; i < 8; i++) {
+            x = 0x01020304 * b + i;
+            memcpy(ref, blk, sizeof(ref));
+            for (th = 0; th < 4; th++)
+                ref[(k + th) / 8] ^= (uint64_t) ((x >> (8 * th)) & 0xFF) <<
+                    (8 * ((k + th) % 8));
+            sha3_keccakf_ref(ref);
+            h = (uint32_t) ref[0];
+            if ((i < 4 && (hv[i] != h || ((m >> i) & 1) != (h < 0x40000000)))
+                || hv[8 + i] != h || ((m8 >> i) & 1) != (h < 0x40000000)) {
+                fprintf(stderr, "round-1 midstate, nonce at %d test "
+                    "FAILED.\n", k);
+                fails++;
+                break;
+            }
+        }
+    }
+
+    // one thread finds the first hit, more threads any hit
+    for (th = 1; th <= 4; th += 3) {
+        nonce = 0xFFFFFFFF;
+        if (sha3_mine(0, 4000, target, th, &nonce, &st) != 1 ||
+            sha3_mine_hash(nonce) >= target || nonce >= 4000 ||
+            (th == 1 && nonce != first)) {
+            fprintf(stderr, "sha3_mine() %d thread search test FAILED.\n",
+                th);
+            fails++;
+        }
+    }
+    if (sha3_mine(0, first, target, 3, &nonce, &st) != 0 ||
+        st.hashes != first ||
+        sha3_mine(0xFFFFFF00, 0x300, 0, 2, &nonce, &st) != 0 ||
+        st.hashes != 0x300) {
+        fprintf(stderr, "sha3_mine() exhaustive search test FAILED.\n");
+        fails++;
+    }
+    if (sha3_mine(0xFFFFFF00, 0x10000, 0x00400000, 2, &nonce, &st) != 1 ||
+        sha3_mine_hash(nonce) >= 0x00400000 ||
+        (uint32_t) (nonce - 0xFFFFFF00) >= 0x10000) {
+        fprintf(stderr, "sha3_mine() wrap-around test FAILED.\n");
+        fails++;
+    }
+
+    return fails;
+}
+
+// header-template jobs of one to three blocks with the nonce at various
+// offsets of the last one (lane straddles, next to the padding), against
+// sha3() of the whole header; templates the midstate cannot take fail
+
+int test_mine_job()
+{
+    const size_t len[6] = { 4, 80, 140, 213, 300, 407 };
+    const size_t off[6] = { 0, 76, 136, 205, 290, 403 };
+    const uint32_t target = 0x01000000;
+    uint8_t hdr[408], md[32];
+    sha3_mine_job_t job;
+    sha3_mine_stats_t st;
+    uint32_t x, h, nonce, first, m, m8, hv[16];
+    int i, j, k, fails;
+
+    fails = 0;
+    for (i = 0; i < 408; i++)
+        hdr[i] = (uint8_t) (i * 0x9D + 0x5B);
+
+    for (j = 0; j < 6; j++) {
+        if (sha3_mine_job_init(&job, hdr, len[j], off[j]) != 1) {
+            fprintf(stderr, "sha3_mine_job_init(%d, %d) test FAILED.\n",
+                (int) len[j], (int) off[j]);
+            fails++;
+            continue;
+        }
+        first = 0xFFFFFFFF;
+        for (i = 0; i < 1024; i += 8) {
+            x = 0x12345678 + (uint32_t) i;
+            m = sha3_impl.mine4(&job.r1, x, target << 4, hv);
+            m8 = sha3_impl.mine8(&job.r1, x, target << 4, hv + 8);
+            for (k = 0; k < 8; k++) {
+                hdr[off[j]] = (uint8_t) (x + k);
+                hdr[off[j] + 1] = (uint8_t) ((x + k) >> 8);
+                hdr[off[j] + 2] = (uint8_t) ((x + k) >> 16);
+                hdr[off[j] + 3] = (uint8_t) ((x + k) >> 24);
+                sha3(hdr, len[j], md, 32);
+                h = md[0] | md[1] << 8 | md[2] << 16 | (uint32_t) md[3] << 24;
+                if (first == 0xFFFFFFFF && h < target)
+                    first = x + k;
+                if (sha3_mine_job_hash(&job, x + k) != h ||
+                    (k < 4 && (hv[k] != h ||
+                    ((m >> k) & 1) != (h < target << 4))) ||
+                    hv[8 + k] != h || ((m8 >> k) & 1) != (h < target << 4)) {
+                    fprintf(stderr, "sha3_mine_job(%d, %d) hash test "
+                        "FAILED.\n", (int) len[j], (int) off[j]);
+                    fails++;
+                    i = 1024;
+                    break;
+                }
+            }
+        }
+        nonce = 0;
+        if (first != 0xFFFFFFFF &&
+            (sha3_mine_job(&job, 0x12345678, 1024, target, 1, &nonce,
+            &st) != 1 || nonce != first)) {
+            fprintf(stderr, "sha3_mine_job(%d, %d) search test FAILED.\n",
+                (int) len[j], (int) off[j]);
+            fails++;
+        }
+    }
+
+    if (sha3_mine_job_init(&job, hdr, 3, 0) != 0 ||
+        sha3_mine_job_init(&job, hdr, 136, 100) != 0 ||
+        sha3_mine_job_init(&job, hdr, 140, 100) != 0 ||
+        sha3_mine_job_init(&job, hdr, 140, 134) != 0 ||
+        sha3_mine_job_init(&job, hdr, 140, 137) != 0) {
+        fprintf(stderr, "sha3_mine_job_init() rejection test FAILED.\n");
+        fails++;
+    }
+
+    return fails;
+}
+
+// sha3sum round trip on names with a newline or backslash: coreutils
+// escaped lines out, -c and --check read them back. needs ./sha3sum
+
+int test_sum()
+{
+    const char *name[3] = { "new\nline", "back\\slash", "plain" };
+    const char *ename[3] = { "\\%s  new\\nline\n", "\\%s  back\\\\slash\n",
+        "%s  plain\n" };
+    char tool[4096], dir[] = "/tmp/sha3sumXXXXXX", sums[64], path[4200];
+    char cmd[8400], hex[65], line[256], want[3][256];
+    uint8_t md[32];
+    FILE *fp;
+    int i, j, seen, fails;
+
+    if (realpath("sha3sum", tool) == NULL || access(tool, X_OK) != 0) {
+        printf("sha3sum round trip skipped (no ./sha3sum).\n");
+        return 0;
+    }
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "sha3sum round trip: no temporary directory.\n");
+        return 1;
+    }
+    snprintf(sums, sizeof(sums), "%s.sums", dir);
+
+    fails = 0;
+    for (i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, name[i]);
+        if ((fp = fopen(path, "w")) != NULL) {
+            fputs(name[i], fp);
+            fclose(fp);
+        }
+        sha3(name[i], strlen(name[i]), md, 32);
+        for (j = 0; j < 32; j++)
+            sprintf(hex + 2 * j, "%02x", md[j]);
+        snprintf(want[i], sizeof(want[i]), ename[i], hex);
+    }
+
+    snprintf(cmd, sizeof(cmd), "cd '%s' && '%s' * > '%s'", dir, tool, sums);
+    if (system(cmd) != 0)
+        fails++;
+    seen = 0;
+    if ((fp = fopen(sums, "r")) != NULL) {
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            for (i = 0; i < 3 && strcmp(line, want[i]) != 0; i++)
+                ;
+            seen += i < 3 ? 1 << i : 8;
+        }
+        fclose(fp);
+    }
+    if (seen != 7)
+        fails++;
+
+    snprintf(cmd, sizeof(cmd), "cd '%s' && '%s' -c '%s' > /dev/null && "
+        "'%s' --check '%s' > /dev/null", dir, tool, sums, tool, sums);
+    if (system(cmd) != 0)
+        fails++;
+
+    for (i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, name[i]);
+        unlink(path);
+    }
+    unlink(sums);
+    rmdir(dir);
+
+    if (fails)
+        fprintf(stderr, "sha3sum escaped name round trip FAILED.\n");
+
+    return fails;
+}
+
+// permutation backends under test
+
+static const struct {
+    const char *name;
+    void (*keccakf)(uint64_t st[25]);
+} test_backend[] = {
+    { "ref",        sha3_keccakf_ref },
+    { "unrolled",   sha3_keccakf_unrolled },
+    { "bi32",       sha3_keccakf_bi32 }
+};
+
+#define TEST_BACKENDS (sizeof(test_backend) / sizeof(test_backend[0]))
+
+// pseudorandom test state (LCG)
+
+static void test_fillstate(uint64_t st[25], uint64_t *seed)
+{
+    int i;
+
+    for (i = 0; i < 25; i++) {
+        *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        st[i] = *seed;
+    }
+}
+
+// bitsliced kernel, including the transposes and a shared lane
+
+static int test_keccakf_bs64(uint64_t *seed)
+{
+    static uint64_t bs[25 * 64], st[64][25], ref[64][25];
+    int k, fails;
+
+    fails = 0;
+    for (k = 0; k < 64; k++) {
+        test_fillstate(st[k], seed);
+        st[k][3] = 0x0123456789ABCDEF;
+        memcpy(ref[k], st[k], sizeof(ref[k]));
+        sha3_keccakf_ref(ref[k]);
+    }
+
+    sha3_bs64_load(bs, st);
+    sha3_bs64_lane_set(&bs[64 * 3], 0x0123456789ABCDEF);
+    sha3_keccakf_bs64(bs);
+    sha3_bs64_store(st, bs);
+
+    for (k = 0; k < 64; k++) {
+        if (memcmp(st[k], ref[k], sizeof(ref[k])) != 0) {
+            fprintf(stderr, "[%d] Keccak-f bs64 test FAILED (%s).\n", k,
+                sha3_backend_name());
+            fails++;
+            break;
+        }
+    }
+
+    return fails;
+}
+
+// multi-state kernels against the reference, through the sha3_ctx_t
+// interleave helpers and the batch API
+
+static int test_keccakf_multi()
+{
+    int i, k, fails;
+    uint64_t seed, v[8 * 25], st[19][25], ref[19][25];
+    sha3_ctx_t ctx[4], *cp[4];
+
+    fails = 0;
+    seed = 0xFEDCBA9876543210;
+
+    for (k = 0; k < 4; k++) {
+        test_fillstate(ctx[k].st.q, &seed);
+        memcpy(ref[k], ctx[k].st.q, sizeof(ref[k]));
+        sha3_keccakf_ref(ref[k]);
+        cp[k] = &ctx[k];
+    }
+    sha3_interleave(v, cp, 4);
+    sha3_keccakf_x4(v);
+    sha3_deinterleave(cp, v, 4);
+    for (k = 0; k < 4; k++) {
+        if (memcmp(ctx[k].st.q, ref[k], sizeof(ref[k])) != 0) {
+            fprintf(stderr, "[%d] Keccak-f x4 test FAILED (%s).\n", k,
+                sha3_backend_name());
+            fails++;
+        }
+    }
+
+    for (k = 0; k < 8; k++) {
+        test_fillstate(st[k], &seed);
+        memcpy(ref[k], st[k], sizeof(ref[k]));
+        sha3_keccakf_ref(ref[k]);
+        for (i = 0; i < 25; i++)
+            v[i * 8 + k] = st[k][i];
+    }
+    sha3_keccakf_x8(v);
+    for (k = 0; k < 8; k++) {
+        for (i = 0; i < 25; i++)
+            st[k][i] = v[i * 8 + k];
+        if (memcmp(st[k], ref[k], sizeof(ref[k])) != 0) {
+            fprintf(stderr, "[%d] Keccak-f x8 test FAILED (%s).\n", k,
+                sha3_backend_name());
+            fails++;
+        }
+    }
+
+    fails += test_keccakf_bs64(&seed);
+
+    for (i = 0; i < 19; i++) {
+        test_fillstate(st[i], &seed);
+        memcpy(ref[i], st[i], sizeof(ref[i]));
+        sha3_keccakf_ref(ref[i]);
+    }
+    sha3_keccakf_batch(st, 19);
+    if (memcmp(st, ref, sizeof(ref)) != 0) {
+        fprintf(stderr, "Keccak-f batch test FAILED.\n");
+        fails++;
+    }
+
+    return fails;
+}
+
+// Keccak-p[1600, n] for every round count, on every scalar backend and
+// on the multi-state kernels, against the reference
+
+static int test_keccakp()
+{
+    const char *scalar[] = { "ref", "unrolled", "bi32" };
+    char saved[32];
+    int i, k, nr, fails;
+    size_t b;
+    uint64_t seed, st[25], ref[25], v[8 * 25], vref[8][25];
+
+    fails = 0;
+    strcpy(saved, sha3_backend_name());
+
+    for (b = 0; b < sizeof(scalar) / sizeof(scalar[0]); b++) {
+        sha3_backend_select(scalar[b]);
+        seed = 0x0F1E2D3C4B5A6978;
+        for (nr = 1; nr <= 24; nr++) {
+            test_fillstate(ref, &seed);
+            memcpy(st, ref, sizeof(st));
+            sha3_keccakp_ref(ref, 24 - nr);
+            keccak_p1600(st, nr);
+            if (memcmp(st, ref, sizeof(ref)) != 0) {
+                fprintf(stderr, "[%d] Keccak-p[1600,%d] test FAILED (%s).\n",
+                    nr, nr, scalar[b]);
+                fails++;
+            }
+        }
+        test_fillstate(ref, &seed);
+        memcpy(st, ref, sizeof(st));
+        sha3_keccakp_ref(ref, 12);
+        keccak_p1600_12(st);
+        if (memcmp(st, ref, sizeof(ref)) != 0) {
+            fprintf(stderr, "Keccak-p[1600,12] test FAILED (%s).\n",
+                scalar[b]);
+            fails++;
+        }
+    }
+    sha3_backend_select(saved);
+
+    for (nr = 1; nr <= 24; nr += 11) {
+        for (k = 0; k < 8; k++) {
+            test_fillstate(vref[k], &seed);
+            for (i = 0; i < 25; i++)
+                v[i * 8 + k] = vref[k][i];
+            sha3_keccakp_ref(vref[k], 24 - nr);
+        }
+        keccak_p1600_x8(v, nr);
+        for (k = 0; k < 8; k++) {
+            for (i = 0; i < 25; i++) {
+                if (v[i * 8 + k] != vref[k][i])
+                    break;
+            }
+            if (i < 25) {
+                fprintf(stderr, "[%d] Keccak-p[1600,%d] x8 test FAILED.\n",
+                    k, nr);
+                fails++;
+            }
+        }
+        for (k = 0; k < 4; k++) {
+            test_fillstate(vref[k], &seed);
+            for (i = 0; i < 25; i++)
+                v[i * 4 + k] = vref[k][i];
+            sha3_keccakp_ref(vref[k], 24 - nr);
+        }
+        keccak_p1600_x4(v, nr);
+        for (k = 0; k < 4; k++) {
+            for (i = 0; i < 25; i++) {
+                if (v[i * 4 + k] != vref[k][i])
+                    break;
+            }
+            if (i < 25) {
+                fprintf(stderr, "[%d] Keccak-p[1600,%d] x4 test FAILED.\n",
+                    k, nr);
+                fails++;
+            }
+        }
+    }
+
+    return fails;
+}
+
+// every scalar backend sha3_backend_select() accepts hashes as the
+// reference does, whatever KECCAKF_ROUNDS is; a reduced-round build takes
+// only "ref". no known answers, so this runs first in any build.
+
+int test_select()
+{
+    const char *scalar[] = { "ref", "unrolled", "bi32" };
+    static uint8_t msg[300];
+    uint8_t md[3][32], ref[3][32];
+    char saved[32];
+    int i, ok, fails;
+    size_t b;
+
+    fails = 0;
+    for (i = 0; i < (int) sizeof(msg); i++)
+        msg[i] = i;
+    strcpy(saved, sha3_backend_name());
+
+    for (b = 0; b < sizeof(scalar) / sizeof(scalar[0]); b++) {
+        ok = sha3_backend_select(scalar[b]);
+        if (ok != (b == 0 || KECCAKF_ROUNDS == 24)) {
+            fprintf(stderr, "Backend %s %s test FAILED.\n", scalar[b],
+                ok ? "accepted" : "refused");
+            fails++;
+        }
+        if (!ok)
+            continue;
+        sha3(msg, sizeof(msg), md[0], 32);
+        sha3_256_chain(md[1], msg, 3);
+        sha3_256_32B_batch(md[2], msg, 1);
+        if (b == 0)
+            memcpy(ref, md, sizeof(ref));
+        if (memcmp(md, ref, sizeof(ref)) != 0) {
+            fprintf(stderr, "Backend %s digest test FAILED.\n", scalar[b]);
+            fails++;
+        }
+    }
+    sha3_backend_select(saved);
+
+    return fails;
+}
+
+// all backends must match the reference bit for bit
+
+int test_keccakf()
+{
+    const char *isa[] = { "generic", "avx2", "avx512" };
+    char saved[32];
+    int i, fails;
+    size_t k;
+    uint64_t st[25], ref[25], seed;
+
+    fails = 0;
+    for (k = 1; k < TEST_BACKENDS; k++) {
+        seed = 0x0123456789ABCDEF;
+        for (i = 0; i < 100; i++) {
+            test_fillstate(ref, &seed);
+            memcpy(st, ref, sizeof(st));
+            sha3_keccakf_ref(ref);
+            test_backend[k].keccakf(st);
+            if (memcmp(st, ref, sizeof(ref)) != 0) {
+                fprintf(stderr, "[%d] Keccak-f backend %s test FAILED.\n",
+                    i, test_backend[k].name);
+                fails++;
+                break;
+            }
+        }
+    }
+
+    // multi-state kernels at every instruction set level the CPU has
+    strcpy(saved, sha3_backend_name());
+    for (k = 0; k < sizeof(isa) / sizeof(isa[0]); k++) {
+        if (sha3_backend_select(isa[k]))
+            fails += test_keccakf_multi();
+    }
+    sha3_backend_select(saved);
+
+    fails += test_keccakp();
+
+    return fails;
+}
+
 // test speed of the comp
 
-void test_speed()
+static void test_speed_keccakf(const char *name,
+    void (*keccakf)(uint64_t st[25]), int nr)
 {
     int i;
     uint64_t st[25], x, n;
@@ -169,7 +1522,7 @@ void test_speed()
     n = 0;
     do {
         for (i = 0; i < 100000; i++)
-            sha3_keccakf(st);
+            keccakf(st);
         n += i;
         us = clock() - bg;
     } while (us < 3 * CLOCKS_PER_SEC);
@@ -178,19 +1531,569 @@ void test_speed()
     for (i = 0; i < 25; i++)
         x += st[i];
 
-    printf("(%016lX) %.3f Keccak-p[1600,24] / Second.\n",
-        (unsigned long) x, (CLOCKS_PER_SEC * ((double) n)) / ((double) us));
+    printf("(%016lX) %.3f Keccak-p[1600,%d] / Second (%s).\n",
+        (unsigned long) x, (CLOCKS_PER_SEC * ((double) n)) / ((double) us),
+        nr, name);
+}
+
+static void test_speed_keccakf_multi(const char *name,
+    void (*keccakf)(uint64_t *st), int ways)
+{
+    int i;
+    static uint64_t st[64 * 25];
+    uint64_t x, n;
+    clock_t bg, us;
+
+    for (i = 0; i < 25 * ways; i++)
+        st[i] = i;
+
+    bg = clock();
+    n = 0;
+    do {
+        for (i = 0; i < 100000 / ways; i++)
+            keccakf(st);
+        n += i * ways;
+        us = clock() - bg;
+    } while (us < 3 * CLOCKS_PER_SEC);
+
+    x = 0;
+    for (i = 0; i < 25 * ways; i++)
+        x += st[i];
+
+    printf("(%016lX) %.3f Keccak-p[1600,24] / Second (%s).\n",
+        (unsigned long) x, (CLOCKS_PER_SEC * ((double) n)) / ((double) us),
+        name);
+}
+
+// large-message absorb rate against the bare permutation bound
+
+static void test_speed_update()
+{
+    static uint8_t buf[1 << 20];
+    void (*volatile f)(uint64_t st[25]) = sha3_keccakf;
+    const size_t len = sizeof(buf) - 8, nperm = len / 136;
+    uint8_t md[32];
+    uint64_t st[25], n, np;
+    sha3_ctx_t sha3;
+    clock_t bg, us, up;
+    double perm, mb;
+    size_t i;
+
+    // the bound: the permutation sha3_update() calls, once per rate
+    // block of the same buffer; the two alternate so they see the same
+    // clock speed and are timed for the same 3 seconds each
+    memset(buf, 0x5A, sizeof(buf));
+    memset(st, 0, sizeof(st));
+    sha3_init(&sha3, 32);
+    n = 0;
+    np = 0;
+    us = 0;
+    up = 0;
+    while (us < 3 * CLOCKS_PER_SEC || up < 3 * CLOCKS_PER_SEC) {
+        bg = clock();
+        sha3_update(&sha3, buf + (n & 7), len);
+        us += clock() - bg;
+        n += len;
+
+        bg = clock();
+        for (i = 0; i < nperm; i++)
+            f(st);
+        up += clock() - bg;
+        np += nperm;
+    }
+    sha3_final(md, &sha3);
+    mb = ((double) n) * CLOCKS_PER_SEC / (1e6 * us);
+    perm = 136.0 * np * CLOCKS_PER_SEC / (1e6 * up);
+
+    printf("(%02X%02X%02X%02X) %.1f MB/s SHA3-256 update, "
+        "%.1f MB/s permutation bound (%.1f%%).\n",
+        md[0], md[1], md[2], md[3], mb, perm,
+        100.0 * mb / perm);
+}
+
+// short independent messages per second: sha3() one at a time, then
+// sha3_batch() with a batch of one and with large batches, then the
+// fixed-length entry points
+
+static void test_speed_batch()
+{
+    static uint8_t msg[1024][64], md[1024][32];
+    static sha3_job_t job[1024];
+    uint64_t n;
+    clock_t bg, us;
+    int i, b;
+
+    for (i = 0; i < 1024; i++) {
+        memset(msg[i], i, 64);
+        job[i].in = msg[i];
+        job[i].inlen = 64;
+        job[i].md = md[i];
+    }
+
+    for (b = 0; b < 5; b++) {
+        bg = clock();
+        n = 0;
+        do {
+            if (b == 0) {
+                for (i = 0; i < 1024; i++)
+                    sha3(msg[i], 64, md[i], 32);
+            } else if (b == 1) {
+                for (i = 0; i < 1024; i++)
+                    sha3_batch(&job[i], 1, 32);
+            } else if (b == 2) {
+                sha3_batch(job, 1024, 32);
+            } else if (b == 3) {
+                for (i = 0; i < 1024; i++)
+                    sha3_256_64B(md[i], msg[i]);
+            } else {
+                sha3_256_64B_batch(md, msg, 1024);
+            }
+            n += 1024;
+            us = clock() - bg;
+        } while (us < 2 * CLOCKS_PER_SEC);
+
+        printf("(%02X%02X%02X%02X) %.0f 64-byte SHA3-256 messages / Second "
+            "(%s).\n", md[1023][0], md[1023][1], md[1023][2], md[1023][3],
+            (CLOCKS_PER_SEC * ((double) n)) / ((double) us),
+            b == 0 ? "sha3" : b == 1 ? "batch of 1" :
+            b == 2 ? "batch of 1024" : b == 3 ? "sha3_256_64B" :
+            "sha3_256_64B_batch");
+    }
+}
+
+// 32-byte suffixes after a 1000-byte prefix: absorbing the prefix every
+// time, restoring a snapshot, and sha3_batch_suffix()
+
+static void test_speed_midstate()
+{
+    static uint8_t pfx[1000], sfx[1024][32], md[1024][32];
+    static sha3_job_t job[1024];
+    sha3_ctx_t mid, c;
+    uint64_t n;
+    clock_t bg, us;
+    int i, b;
+
+    memset(pfx, 0xA5, sizeof(pfx));
+    for (i = 0; i < 1024; i++) {
+        memset(sfx[i], i, 32);
+        job[i].in = sfx[i];
+        job[i].inlen = 32;
+        job[i].md = md[i];
+    }
+    sha3_init(&mid, 32);
+    sha3_update(&mid, pfx, sizeof(pfx));
+
+    for (b = 0; b < 3; b++) {
+        bg = clock();
+        n = 0;
+        do {
+            for (i = 0; b < 2 && i < 1024; i++) {
+                if (b == 0) {
+                    sha3_init(&c, 32);
+                    sha3_update(&c, pfx, sizeof(pfx));
+                } else {
+                    sha3_ctx_restore(&c, &mid);
+                }
+                sha3_update(&c, sfx[i], 32);
+                sha3_final(md[i], &c);
+            }
+            if (b == 2)
+                sha3_batch_suffix(&mid, job, 1024);
+            n += 1024;
+            us = clock() - bg;
+        } while (us < 2 * CLOCKS_PER_SEC);
+
+        printf("(%02X%02X%02X%02X) %.0f prefixed SHA3-256 suffixes / Second "
+            "(%s).\n", md[1023][0], md[1023][1], md[1023][2], md[1023][3],
+            (CLOCKS_PER_SEC * ((double) n)) / ((double) us),
+            b == 0 ? "full" : b == 1 ? "restore" : "batch");
+    }
+}
+
+// bulk random output: one SHAKE128 stream, eight in parallel, the PRNG
+
+static void test_speed_xof()
+{
+    static uint8_t buf[SHA3_MAX_WAYS][1 << 17];
+    static sha3_prng_t g;
+    sha3_ctx_t c[SHA3_MAX_WAYS];
+    sha3_ctx_t *cp[SHA3_MAX_WAYS];
+    void *op[SHA3_MAX_WAYS];
+    uint64_t n;
+    clock_t bg, us;
+    int b, k;
+
+    sha3_prng_init(&g, "seed", 4);
+
+    for (b = 0; b < 3; b++) {
+        for (k = 0; k < SHA3_MAX_WAYS; k++) {     // all at the same position
+            shake128_init(&c[k]);
+            shake_xof(&c[k]);
+            cp[k] = &c[k];
+            op[k] = buf[k];
+        }
+        bg = clock();
+        n = 0;
+        do {
+            if (b == 0) {
+                shake_out(&c[0], buf[0], sizeof(buf[0]));
+                n += sizeof(buf[0]);
+            } else if (b == 1) {
+                shake_out_multi(cp, op, SHA3_MAX_WAYS, sizeof(buf[0]));
+                n += sizeof(buf);
+            } else {
+                sha3_prng_fill(&g, buf, sizeof(buf));
+                n += sizeof(buf);
+            }
+            us = clock() - bg;
+        } while (us < 2 * CLOCKS_PER_SEC);
+
+        printf("(%02X%02X%02X%02X) %.3f GB/s %s.\n",
+            buf[0][0], buf[0][1], buf[0][2], buf[0][3],
+            1E-9 * (CLOCKS_PER_SEC * ((double) n)) / ((double) us),
+            b == 0 ? "SHAKE128 output" : b == 1 ?
+            "SHAKE128 output, 8 streams" : "PRNG fill");
+    }
+}
+
+// KangarooTwelve on a 64 MiB buffer with 1, 2, 4 .. threads, one per
+// CPU at most. wall-clock time, since clock() adds up all threads
+
+static double test_wallclock()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1E-9 * ts.tv_nsec;
+}
+
+static void test_speed_k12()
+{
+    const size_t len = 1 << 26;
+    static uint8_t buf[1 << 26];
+    uint8_t md[32];
+    double bg, t;
+    uint64_t n;
+    int cpus, th;
+
+    memset(buf, 0x5A, len);
+    cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    for (th = 1; th == 1 || th <= cpus; th *= 2) {
+        bg = test_wallclock();
+        n = 0;
+        do {
+            kangarootwelve(buf, len, NULL, 0, md, sizeof(md), th);
+            n += len;
+            t = test_wallclock() - bg;
+        } while (t < 2.0);
+
+        printf("(%02X%02X%02X%02X) %.1f MB/s KangarooTwelve, %d thread%s.\n",
+            md[0], md[1], md[2], md[3], 1E-6 * n / t, th, th > 1 ? "s" : "");
+    }
+}
+
+// SP 800-185 on a 16 MiB buffer: sequential KMAC128 and TupleHash128
+// against ParallelHash128 (B = 8 KiB) on one thread and on all CPUs
+
+static void test_speed_sp800185()
+{
+    const size_t len = 1 << 24;
+    static uint8_t buf[1 << 24];
+    uint8_t md[32];
+    sha3_ctx_t c;
+    double bg, t;
+    uint64_t n;
+    int b, cpus;
+
+    memset(buf, 0xA5, len);
+    cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    for (b = 0; b < 4; b++) {
+        bg = test_wallclock();
+        n = 0;
+        do {
+            if (b == 0) {
+                kmac_init(&c, 128, "key", 3, "", 0);
+                sha3_update(&c, buf, len);
+                kmac_final(&c, md, sizeof(md));
+            } else if (b == 1) {
+                tuplehash_init(&c, 128, "", 0);
+                tuplehash_add(&c, buf, len);
+                tuplehash_final(&c, md, sizeof(md));
+            } else {
+                parallelhash(128, buf, len, 8192, "", 0, md, sizeof(md), 0,
+                    b == 2 ? 1 : cpus);
+            }
+            n += len;
+            t = test_wallclock() - bg;
+        } while (t < 2.0);
+
+        printf("(%02X%02X%02X%02X) %.1f MB/s %s", md[0], md[1], md[2], md[3],
+            1E-6 * n / t, b == 0 ? "KMAC128" : b == 1 ? "TupleHash128" :
+            "ParallelHash128");
+        if (b >= 2)
+            printf(", %d thread%s", b == 2 ? 1 : cpus,
+                b == 2 || cpus == 1 ? "" : "s");
+        printf(".\n");
+    }
+}
+
+// one 64 MiB file through the read/hash pipeline, cached and O_DIRECT,
+// against sha3() of the same bytes in memory
+
+static void test_speed_stream()
+{
+    const size_t len = 1 << 26;
+    static uint8_t buf[1 << 26];
+    char path[] = "/tmp/sha3testXXXXXX";
+    sha3_stream_stats_t st;
+    uint8_t md[32];
+    double bg, t;
+    uint64_t n;
+    int b, fd;
+
+    memset(buf, 0xC3, len);
+    if ((fd = mkstemp(path)) < 0)
+        return;
+    if (write(fd, buf, len) != (ssize_t) len) {
+        close(fd);
+        unlink(path);
+        return;
+    }
+    close(fd);
+
+    for (b = 0; b < 3; b++) {
+        bg = test_wallclock();
+        n = 0;
+        memset(&st, 0, sizeof(st));
+        do {
+            if (b == 0)
+                sha3(buf, len, md, 32);
+            else
+                sha3_stream_file(path, md, 32,
+                    b == 2 ? SHA3_STREAM_DIRECT : 0, &st);
+            n += len;
+            t = test_wallclock() - bg;
+        } while (t < 2.0);
 
+        printf("(%02X%02X%02X%02X) %.1f MB/s SHA3-256 %s", md[0], md[1],
+            md[2], md[3], 1E-6 * n / t, b == 0 ? "in memory" :
+            b == 1 ? "stream" : "stream, O_DIRECT");
+        if (b > 0)
+            printf(" (last pass: %d read / %d hash stalls, %.0f / %.0f ms)",
+                (int) st.read_stalls, (int) st.hash_stalls,
+                1E3 * st.read_stall_s, 1E3 * st.hash_stall_s);
+        printf(".\n");
+    }
+    unlink(path);
+}
 
+// a 10 GB sparse file in 64 KiB leaves: full tree build, then a 1 MB
+// edit rehashed through the node cache
+
+static void test_speed_merkle()
+{
+    const uint64_t size = 10000000000ULL;
+    static uint8_t edit[1 << 20];
+    char path[] = "/tmp/sha3testXXXXXX", cache[40];
+    sha3_merkle_t t;
+    uint8_t md[32];
+    double bg, t0, t1;
+    int fd, th, cpus;
+
+    if ((fd = mkstemp(path)) < 0)
+        return;
+    snprintf(cache, sizeof(cache), "%s.mt", path);
+    memset(edit, 0x96, sizeof(edit));
+    cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (ftruncate(fd, size) == 0) {
+        for (th = 1; th == 1 || th <= cpus; th *= 2) {
+            unlink(cache);
+            bg = test_wallclock();
+            sha3_merkle_open(&t, path, cache, 1 << 16, th);
+            sha3_merkle_root(&t, md);
+            sha3_merkle_close(&t);
+            t0 = test_wallclock() - bg;
+
+            if (pwrite(fd, edit, sizeof(edit), size / 3) != sizeof(edit))
+                break;
+            edit[0]++;
+            bg = test_wallclock();
+            sha3_merkle_open(&t, path, cache, 1 << 16, th);
+            sha3_merkle_dirty(&t, size / 3, sizeof(edit));
+            sha3_merkle_root(&t, md);
+            sha3_merkle_close(&t);
+            t1 = test_wallclock() - bg;
+
+            printf("(%02X%02X%02X%02X) SHA3-256 Merkle, 10 GB: %.1f s full "
+                "(%.1f MB/s), %.1f ms after a 1 MB edit, %d thread%s.\n",
+                md[0], md[1], md[2], md[3], t0, 1E-6 * size / t0, 1E3 * t1,
+                th, th > 1 ? "s" : "");
+        }
+    }
+    close(fd);
+    unlink(path);
+    unlink(cache);
 }
 
-// main
+// hash_nonce() rate of the scalar and batched forms, then the search with
+// an unreachable target on 1 .. all CPUs threads
+
+static void test_speed_mine()
+{
+    sha3_mine_job_t job;
+    sha3_mine_stats_t st;
+    uint8_t hdr[300];
+    uint32_t nonce, m, acc;
+    uint64_t m64, n;
+    clock_t bg, us;
+    int b, cpus, th, t;
+
+    for (b = 0; b < 4; b++) {
+        bg = clock();
+        n = 0;
+        acc = 0;
+        do {
+            for (t = 0; t < 1024; t++) {
+                if (b == 0) {
+                    acc ^= sha3_mine_hash((uint32_t) n);
+                    n++;
+                } else if (b == 1) {
+                    sha3_mine_hash_x4((uint32_t) n, 0x1000, &m, NULL);
+                    acc ^= m;
+                    n += 4;
+                } else if (b == 2) {
+                    sha3_mine_hash_x8((uint32_t) n, 0x1000, &m, NULL);
+                    acc ^= m;
+                    n += 8;
+                } else {
+                    sha3_mine_hash_x64((uint32_t) n, 0x1000, &m64, NULL);
+                    acc ^= (uint32_t) m64;
+                    n += 64;
+                }
+            }
+            us = clock() - bg;
+        } while (us < 2 * CLOCKS_PER_SEC);
+
+        printf("(%08X) %.3f MH/s hash_nonce%s.\n", acc,
+            1E-6 * CLOCKS_PER_SEC * ((double) n) / ((double) us),
+            b == 0 ? "" : b == 1 ? "_x4" : b == 2 ? "_x8" : "_x64");
+    }
+
+    cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    for (th = 1; th == 1 || th <= cpus; th *= 2) {
+        sha3_mine(0, 1 << 24, 0, th, &nonce, &st);
+        printf("%.3f MH/s nonce search, %d thread%s, %d steals (", 1E-6 *
+            st.hashes / st.seconds, th, th > 1 ? "s" : "", (int) st.steals);
+        for (t = 0; t < st.nthreads; t++)
+            printf("%s%.3f", t > 0 ? " " : "", 1E-6 * st.thread_hashes[t] /
+                st.thread_seconds[t]);
+        printf(" MH/s per thread).\n");
+    }
+
+    // a 300-byte header template: two blocks in the midstate
+    memset(hdr, 0x5A, sizeof(hdr));
+    sha3_mine_job_init(&job, hdr, sizeof(hdr), 290);
+    sha3_mine_job(&job, 0, 1 << 24, 0, cpus, &nonce, &st);
+    printf("%.3f MH/s nonce search, 300-byte header, %d thread%s.\n",
+        1E-6 * st.hashes / st.seconds, st.nthreads,
+        st.nthreads > 1 ? "s" : "");
+}
+
+// SHA3-256 hash chain steps per second: sha3() in a loop, the register
+// chain, and eight chains side by side
+
+static void test_speed_chain()
+{
+    uint8_t md[8 * 32];
+    uint64_t n;
+    clock_t bg, us;
+    int b, i;
+
+    memset(md, 0x3C, sizeof(md));
+    for (b = 0; b < 3; b++) {
+        bg = clock();
+        n = 0;
+        do {
+            if (b == 0) {
+                for (i = 0; i < 1000; i++)
+                    sha3(md, 32, md, 32);
+                n += 1000;
+            } else if (b == 1) {
+                sha3_256_chain(md, md, 1000);
+                n += 1000;
+            } else {
+                sha3_256_chain_batch(md, md, 8, 1000);
+                n += 8000;
+            }
+            us = clock() - bg;
+        } while (us < 2 * CLOCKS_PER_SEC);
+
+        printf("(%02X%02X%02X%02X) %.0f SHA3-256 chain steps / Second "
+            "(%s).\n", md[0], md[1], md[2], md[3],
+            (CLOCKS_PER_SEC * ((double) n)) / ((double) us),
+            b == 0 ? "sha3" : b == 1 ? "sha3_256_chain" : "8 chains");
+    }
+}
+
+// benchmarks; big adds the ones that need a 10 GB sparse file in /tmp
+
+void test_speed(int big)
+{
+    size_t k;
+
+    printf("Backend: %s\n", sha3_backend_name());
+    for (k = 0; k < TEST_BACKENDS; k++)
+        test_speed_keccakf(test_backend[k].name, test_backend[k].keccakf,
+            24);
+    test_speed_keccakf("p12", keccak_p1600_12, 12);
+    test_speed_keccakf_multi("x4", sha3_keccakf_x4, 4);
+    test_speed_keccakf_multi("x8", sha3_keccakf_x8, 8);
+    test_speed_keccakf_multi("bs64", sha3_keccakf_bs64, 64);
+    test_speed_update();
+    test_speed_batch();
+    test_speed_midstate();
+    test_speed_chain();
+    test_speed_xof();
+    test_speed_k12();
+    test_speed_sp800185();
+    test_speed_stream();
+    if (big)
+        test_speed_merkle();
+    test_speed_mine();
+}
+
+// main: self-tests; -s also runs the benchmarks, -S those and the large
+// file ones. exits 1 when a self-test fails.
 int main(int argc, char **argv)
 {
-    if (test_sha3() == 0 && test_shake() == 0)
-        printf("FIPS 202 / SHA3, SHAKE128, SHAKE256 Self-Tests OK!\n");
-    test_speed();
+    int opt, speed;
+
+    speed = 0;
+    while ((opt = getopt(argc, argv, "sS")) != -1) {
+        switch (opt) {
+            case 's':
+                speed = speed > 1 ? speed : 1;
+                break;
+            case 'S':
+                speed = 2;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-s | -S]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (test_select() != 0 ||
+        test_sha3() != 0 || test_shake() != 0 || test_sponge() != 0 ||
+        test_xof() != 0 || test_k12() != 0 || test_sp800185() != 0 ||
+        test_batch() != 0 || test_fixed() != 0 || test_chain() != 0 ||
+        test_midstate() != 0 || test_stream() != 0 || test_merkle() != 0 ||
+        test_mine() != 0 || test_mine_job() != 0 || test_sum() != 0 ||
+        test_keccakf() != 0)
+        return 1;
+    printf("FIPS 202 / SHA3, SHAKE128, SHAKE256 Self-Tests OK!\n");
+    if (speed)
+        test_speed(speed > 1);
 
     return 0;
 }
-
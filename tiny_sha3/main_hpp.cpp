@@ -0,0 +1,155 @@
+// main_hpp.cpp
+// Self-tests for the C++ wrapper: compile-time digests are checked with
+// static_assert, run-time ones against the C API.
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include "sha3.hpp"
+
+using namespace tiny_sha3;
+
+// hex to bytes at compile time
+
+template <size_t N>
+constexpr std::array<uint8_t, N> hex(const char *s)
+{
+    std::array<uint8_t, N> b = {};
+    for (size_t i = 0; i < 2 * N; i++) {
+        char ch = s[i];
+        int d = ch <= '9' ? ch - '0' : (ch | 0x20) - 'a' + 10;
+        b[i / 2] = uint8_t((b[i / 2] << 4) | d);
+    }
+    return b;
+}
+
+// std::array comparison is only constexpr from C++20
+
+template <size_t N>
+constexpr bool same(const std::array<uint8_t, N> &a,
+    const std::array<uint8_t, N> &b)
+{
+    for (size_t i = 0; i < N; i++) {
+        if (a[i] != b[i])
+            return false;
+    }
+    return true;
+}
+
+// known answers hold for the full 24 rounds only
+#if KECCAKF_ROUNDS == 24
+static_assert(same(Sha3_256::hash("abc"), hex<32>(
+    "3a985da74fe225b2045c172d6bd390bd855f086e3e9d525b46bfe24511431532")));
+static_assert(same(Sha3_224::hash(""), hex<28>(
+    "6b4e03423667dbb73b6e15454f0eb1abd4597f9a1b078e3f5b5a6bc7")));
+static_assert(same(Sha3_512::hash(
+    "The quick brown fox jumps over the lazy dog"
+    "The quick brown fox jumps over the lazy dog"
+    "The quick brown fox jumps over the lazy dog"
+    "The quick brown fox jumps over the lazy dog"), hex<64>(
+    "e86b3aeaad91f628c47a36577982a3017468f24d20b706188b857f40c280bb99"
+    "f51920872db1669b65b94ceb62879a23561bb0bc48626f8b72e6f2817db90486")));
+static_assert(same(Shake128::hash<32>(""), hex<32>(
+    "7f9c2ba4e88f827d616045507605853ed73b8093f6efbc88eb1a6eacfa66ef26")));
+
+// bytes 168..199 of SHAKE256("abc"), past the first squeezed block
+constexpr std::array<uint8_t, 32> shake256_tail()
+{
+    std::array<uint8_t, 200> out = {};
+    Shake256 h;
+    h.update("abc");
+    h.squeeze(out.data(), 100);
+    h.squeeze(out.data() + 100, 100);
+    std::array<uint8_t, 32> t = {};
+    for (size_t i = 0; i < 32; i++)
+        t[i] = out[168 + i];
+    return t;
+}
+
+static_assert(same(shake256_tail(), hex<32>(
+    "9442b99903f4dcfd8559ed3950faf40fe6f3b5d710ed3b677513771af6bfe119")));
+#endif
+
+// made at compile time, checked against sha3() at run time below: the two
+// permutations must agree for any KECCAKF_ROUNDS
+constexpr const char ct_msg[] = "Sha3<256> at compile time";
+constexpr std::array<uint8_t, 32> ct_md = Sha3_256::hash(ct_msg);
+
+// run time: the dispatched permutation, against sha3() and shake_out()
+
+template <int Bits>
+static int test_sha3_rt(const uint8_t *msg, size_t len)
+{
+    uint8_t ref[Bits / 8];
+    Sha3<Bits> h;
+
+    h.update(msg, len / 3).update(msg + len / 3, len - len / 3);
+    auto md = h.final();
+    sha3(msg, len, ref, Bits / 8);
+    if (memcmp(md.data(), ref, sizeof(ref)) != 0) {
+        fprintf(stderr, "Sha3<%d>, len %d test FAILED.\n", Bits, (int) len);
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    static uint8_t msg[1000], out[500], ref[500];
+    sha3_ctx_t c;
+    int fails = 0;
+    size_t len;
+
+    for (size_t i = 0; i < sizeof(msg); i++)
+        msg[i] = uint8_t(i * 31 + (i >> 5));
+
+    for (len = 0; len < sizeof(msg); len += 67) {
+        fails += test_sha3_rt<224>(msg, len);
+        fails += test_sha3_rt<256>(msg, len);
+        fails += test_sha3_rt<384>(msg, len);
+        fails += test_sha3_rt<512>(msg, len);
+    }
+
+    // clone of a midstate, then a moved-from hasher carries on
+    Sha3_256 mid;
+    mid.update(msg, 300);
+    Sha3_256 fork = mid.clone();
+    fork.update(msg + 300, 200);
+    Sha3_256 moved = std::move(mid);
+    moved.update(msg + 300, 200);
+    if (fork.final() != moved.final()) {
+        fprintf(stderr, "Sha3<256> clone test FAILED.\n");
+        fails++;
+    }
+    auto md = Sha3_256::hash(msg, 500);
+    sha3(msg, 500, ref, 32);
+    if (memcmp(md.data(), ref, 32) != 0) {
+        fprintf(stderr, "Sha3<256> hash test FAILED.\n");
+        fails++;
+    }
+
+    sha3(ct_msg, sizeof(ct_msg) - 1, ref, 32);
+    if (memcmp(ct_md.data(), ref, 32) != 0) {
+        fprintf(stderr, "Sha3<256> constexpr against run time test "
+            "FAILED.\n");
+        fails++;
+    }
+
+    Shake128 xof;
+    xof.update(msg, 777);
+    xof.squeeze(out, 123);
+    xof.squeeze(out + 123, sizeof(out) - 123);
+    shake128_init(&c);
+    shake_update(&c, msg, 777);
+    shake_xof(&c);
+    shake_out(&c, ref, sizeof(ref));
+    if (memcmp(out, ref, sizeof(out)) != 0) {
+        fprintf(stderr, "Shake<128> test FAILED.\n");
+        fails++;
+    }
+
+    if (fails == 0)
+        printf("C++ Sha3<>, Shake<> Self-Tests OK!\n");
+
+    return fails != 0;
+}
@@ -4,11 +4,14 @@
 // Revised 07-Aug-15 to match with official release of FIPS PUB 202 "SHA3"
 // Revised 03-Sep-15 for portability + OpenSSL - style API
 
+#include <string.h>
+#include <sys/uio.h>
 #include "sha3.h"
+#include "sha3_dispatch.h"
 
-// update the state with given number of rounds
+// update the state with rounds r0..r1-1 (table-driven reference)
 
-void sha3_keccakf(uint64_t st[25])
+static void keccak_rounds(uint64_t st[25], int r0, int r1)
 {
     // constants
     const uint64_t keccakf_rndc[24] = {
@@ -48,7 +51,7 @@ void sha3_keccakf(uint64_t st[25])
 #endif
 
     // actual iteration
-    for (r = 0; r < KECCAKF_ROUNDS; r++) {
+    for (r = r0; r < r1; r++) {
 
         // Theta
         for (i = 0; i < 5; i++)
@@ -98,6 +101,18 @@ void sha3_keccakf(uint64_t st[25])
 #endif
 }
 
+void sha3_keccakf_ref(uint64_t st[25])
+{
+    keccak_rounds(st, 0, KECCAKF_ROUNDS);
+}
+
+// Keccak-p[1600, 24 - r0]: the last rounds of Keccak-f
+
+void sha3_keccakp_ref(uint64_t st[25], int r0)
+{
+    keccak_rounds(st, r0, 24);
+}
+
 // Initialize the context for SHA3
 
 int sha3_init(sha3_ctx_t *c, int mdlen)
@@ -109,43 +124,149 @@ int sha3_init(sha3_ctx_t *c, int mdlen)
     c->mdlen = mdlen;
     c->rsiz = 200 - 2 * mdlen;
     c->pt = 0;
+    c->dsbyte = 0x06;
 
     return 1;
 }
 
-// update state with more data
+// XOR n bytes into the state at byte offset j, j + n <= rate. whole lanes
+// go in as aligned 64-bit words; bytes only at an unaligned head and tail.
+// byte order does not matter for XOR, so this is endian-neutral.
 
-int sha3_update(sha3_ctx_t *c, const void *data, size_t len)
+static void sha3_xorin(sha3_ctx_t *c, int j, const uint8_t *in, size_t n)
+{
+    uint64_t t;
+
+    for (; n > 0 && (j & 7) != 0; n--)
+        c->st.b[j++] ^= *in++;
+
+    for (; n >= 8; n -= 8) {
+        memcpy(&t, in, 8);
+        c->st.q[j >> 3] ^= t;
+        j += 8;
+        in += 8;
+    }
+
+    for (; n > 0; n--)
+        c->st.b[j++] ^= *in++;
+}
+
+// with the bit-interleaved backend bound, whole blocks skip the per-block
+// lane conversion of sha3_keccakf_bi32(): the first round of f there, or
+// -1 to go through f
+
+static int sponge_bi32(const sha3_ctx_t *c, void (*f)(uint64_t st[25]))
+{
+    if (sha3_impl.keccakf != sha3_keccakf_bi32 || (c->rsiz & 7) != 0)
+        return -1;
+
+    return f == sha3_keccakf ? 0 : f == keccak_p1600_12 ? 12 : -1;
+}
+
+// absorb more data, a rate block at a time, with permutation f
+
+static void sponge_absorb(sha3_ctx_t *c, const uint8_t *in, size_t len,
+    void (*f)(uint64_t st[25]))
+{
+    size_t n;
+    int j, r0;
+
+    j = c->pt;
+    while (len > 0) {
+        if (j == 0 && len >= (size_t) c->rsiz &&
+            (r0 = sponge_bi32(c, f)) >= 0) {
+            n = sha3_bi32_absorb(c->st.q, in, len, c->rsiz, r0);
+            in += n;
+            len -= n;
+            continue;
+        }
+        n = c->rsiz - j;
+        if (n > len)
+            n = len;
+        sha3_xorin(c, j, in, n);
+        j += n;
+        in += n;
+        len -= n;
+        if (j >= c->rsiz) {
+            f(c->st.q);
+            j = 0;
+        }
+    }
+    c->pt = j;
+}
+
+// squeeze a rate block (or what is left of it) at a time
+
+static void sponge_squeeze(sha3_ctx_t *c, uint8_t *out, size_t len,
+    void (*f)(uint64_t st[25]))
 {
-    size_t i;
-    int j;
+    size_t n;
+    int j, r0;
 
     j = c->pt;
-    for (i = 0; i < len; i++) {
-        c->st.b[j++] ^= ((const uint8_t *) data)[i];
+    while (len > 0) {
+        if (j >= c->rsiz && len >= (size_t) c->rsiz &&
+            (r0 = sponge_bi32(c, f)) >= 0) {
+            n = sha3_bi32_squeeze(c->st.q, out, len, c->rsiz, r0);
+            out += n;
+            len -= n;
+            continue;
+        }
         if (j >= c->rsiz) {
-            sha3_keccakf(c->st.q);
+            f(c->st.q);
             j = 0;
         }
+        n = c->rsiz - j;
+        if (n > len)
+            n = len;
+        memcpy(out, &c->st.b[j], n);
+        j += n;
+        out += n;
+        len -= n;
     }
     c->pt = j;
+}
+
+// update state with more data
+
+int sha3_update(sha3_ctx_t *c, const void *data, size_t len)
+{
+    sponge_absorb(c, (const uint8_t *) data, len, sha3_keccakf);
 
     return 1;
 }
 
-// finalize and output a hash
+// update from several buffers. each piece goes straight into the state;
+// a block may straddle pieces, whole blocks inside a piece are absorbed
+// a lane at a time as in sha3_update().
 
-int sha3_final(void *md, sha3_ctx_t *c)
+int sha3_updatev(sha3_ctx_t *c, const struct iovec *iov, int n)
 {
     int i;
 
-    c->st.b[c->pt] ^= 0x06;
+    for (i = 0; i < n; i++)
+        sha3_update(c, iov[i].iov_base, iov[i].iov_len);
+
+    return 1;
+}
+
+// finalize and output a hash
+
+int sha3_final(void *md, sha3_ctx_t *c)
+{
+    c->st.b[c->pt] ^= c->dsbyte;
     c->st.b[c->rsiz - 1] ^= 0x80;
     sha3_keccakf(c->st.q);
+    memcpy(md, c->st.b, c->mdlen);
 
-    for (i = 0; i < c->mdlen; i++) {
-        ((uint8_t *) md)[i] = c->st.b[i];
-    }
+    return 1;
+}
+
+// copy the whole context; the state is plain data
+
+int sha3_ctx_clone(sha3_ctx_t *dst, const sha3_ctx_t *src)
+{
+    memcpy(dst, src, sizeof(sha3_ctx_t));
 
     return 1;
 }
@@ -165,27 +286,47 @@ void *sha3(const void *in, size_t inlen, void *md, int mdlen)
 
 // SHAKE128 and SHAKE256 extensible-output functionality
 
+int shake_init(sha3_ctx_t *c, int mdlen)
+{
+    sha3_init(c, mdlen);
+    c->dsbyte = 0x1F;
+
+    return 1;
+}
+
+// pad with the context's domain byte and switch to output
+
 void shake_xof(sha3_ctx_t *c)
 {
-    c->st.b[c->pt] ^= 0x1F;
+    c->st.b[c->pt] ^= c->dsbyte;
     c->st.b[c->rsiz - 1] ^= 0x80;
     sha3_keccakf(c->st.q);
     c->pt = 0;
 }
 
+// squeeze output
+
 void shake_out(sha3_ctx_t *c, void *out, size_t len)
 {
-    size_t i;
-    int j;
+    sponge_squeeze(c, (uint8_t *) out, len, sha3_keccakf);
+}
 
-    j = c->pt;
-    for (i = 0; i < len; i++) {
-        if (j >= c->rsiz) {
-            sha3_keccakf(c->st.q);
-            j = 0;
-        }
-        ((uint8_t *) out)[i] = c->st.b[j++];
-    }
-    c->pt = j;
+// TurboSHAKE: the SHAKE sponge on Keccak-p[1600, 12]
+
+void turboshake_update(sha3_ctx_t *c, const void *data, size_t len)
+{
+    sponge_absorb(c, (const uint8_t *) data, len, keccak_p1600_12);
+}
+
+void turboshake_xof(sha3_ctx_t *c, uint8_t ds)
+{
+    c->st.b[c->pt] ^= ds;
+    c->st.b[c->rsiz - 1] ^= 0x80;
+    keccak_p1600_12(c->st.q);
+    c->pt = 0;
 }
 
+void turboshake_out(sha3_ctx_t *c, void *out, size_t len)
+{
+    sponge_squeeze(c, (uint8_t *) out, len, keccak_p1600_12);
+}
@@ -15,6 +15,10 @@
 #define ROTL64(x, y) (((x) << (y)) | ((x) >> (64 - (y))))
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // state context
 typedef struct {
     union {                                 // state:
@@ -22,26 +26,294 @@ typedef struct {
         uint64_t q[25];                     // 64-bit words
     } st;
     int pt, rsiz, mdlen;                    // these don't overflow
+    int dsbyte;                             // first pad byte: 0x06 SHA3,
+                                            // 0x1F SHAKE, 0x04 cSHAKE
 } sha3_ctx_t;
 
-// Compression function.
+// Compression function. Bound at run time to the fastest backend.
 void sha3_keccakf(uint64_t st[25]);
 
+// Permutation backends; sha3_keccakf() uses one of these.
+void sha3_keccakf_ref(uint64_t st[25]);         // table-driven reference
+void sha3_keccakf_unrolled(uint64_t st[25]);    // unrolled, lane-complemented
+void sha3_keccakf_bi32(uint64_t st[25]);        // bit-interleaved, 32-bit ops
+
+// Bit-interleaved state for 32-bit cores: st[2 * i] holds the even bits
+// of lane i, st[2 * i + 1] the odd bits. Runs rounds r0..23.
+void sha3_keccakp_bi32(uint32_t st[50], int r0);
+void sha3_bi32_from_lane(uint32_t eo[2], uint64_t lane);
+uint64_t sha3_bi32_to_lane(const uint32_t eo[2]);
+
+// Multi-state permutations. The states are interleaved lane by lane: with
+// n states, lane i of state k is at st[i * n + k], in native byte order.
+#define SHA3_MAX_WAYS 8
+
+void sha3_keccakf_x4(uint64_t st[4 * 25]);
+void sha3_keccakf_x8(uint64_t st[8 * 25]);
+
+// move n <= SHA3_MAX_WAYS contexts to/from the interleaved layout
+void sha3_interleave(uint64_t *st, sha3_ctx_t *const c[], int n);
+void sha3_deinterleave(sha3_ctx_t *const c[], const uint64_t *st, int n);
+
+// permute n independent states on the widest available kernel
+void sha3_keccakf_batch(uint64_t (*st)[25], size_t n);
+
+// Keccak-p[1600, nrounds]: the last 1 <= nrounds <= 24 rounds of Keccak-f,
+// e.g. 12 for KangarooTwelve / TurboSHAKE. Independent of KECCAKF_ROUNDS.
+// keccak_p1600_12 is the 12-round variant without the round-count switch.
+void keccak_p1600(uint64_t st[25], int nrounds);
+void keccak_p1600_12(uint64_t st[25]);
+void keccak_p1600_x4(uint64_t st[4 * 25], int nrounds);
+void keccak_p1600_x8(uint64_t st[8 * 25], int nrounds);
+
+// Backend selection. Resolved once from the CPU features on first use; the
+// SHA3_BACKEND environment variable is applied on top of that. spec is a
+// comma-separated list of a scalar backend ("ref", "unrolled", "bi32")
+// and/or a multi-state level ("generic", "avx2", "avx512"). Levels the CPU
+// lacks are refused, as are scalars other than "ref" when KECCAKF_ROUNDS
+// is not 24. Returns 1 if every item was applied. Rebinding while other
+// threads are hashing is not safe; the first binding is.
+int sha3_backend_select(const char *spec);
+const char *sha3_backend_name(void);        // e.g. "unrolled,avx512"
+int sha3_backend_ways(void);                // widest fast kernel: 4 or 8
+
+// Bitsliced 64-instance permutation (experimental). bs[64 * i + z] holds
+// bit z of lane i; bit k of that word belongs to instance k.
+void sha3_keccakf_bs64(uint64_t bs[25 * 64]);
+
+// transposes: 64 states in sha3_keccakf() format, or single lanes given
+// as 64 native lane values; lane_set puts one value in all instances
+void sha3_bs64_load(uint64_t bs[25 * 64], uint64_t (*const st)[25]);
+void sha3_bs64_store(uint64_t (*st)[25], const uint64_t bs[25 * 64]);
+void sha3_bs64_lane_in(uint64_t bs[64], const uint64_t v[64]);
+void sha3_bs64_lane_out(uint64_t v[64], const uint64_t bs[64]);
+void sha3_bs64_lane_set(uint64_t bs[64], uint64_t v);
+
 // OpenSSL - like interfece
 int sha3_init(sha3_ctx_t *c, int mdlen);    // mdlen = hash output in bytes
 int sha3_update(sha3_ctx_t *c, const void *data, size_t len);
+
+// scatter/gather update: the n pieces in order, as one message
+struct iovec;
+int sha3_updatev(sha3_ctx_t *c, const struct iovec *iov, int n);
 int sha3_final(void *md, sha3_ctx_t *c);    // digest goes to md
 
+// Copy a context, e.g. a midstate after absorbing a shared prefix, to be
+// restored and continued for each suffix.
+int sha3_ctx_clone(sha3_ctx_t *dst, const sha3_ctx_t *src);
+#define sha3_ctx_snapshot(snap, c) sha3_ctx_clone(snap, c)
+#define sha3_ctx_restore(c, snap) sha3_ctx_clone(c, snap)
+
 // compute a sha3 hash (md) of given byte length from "in"
 void *sha3(const void *in, size_t inlen, void *md, int mdlen);
 
-// SHAKE128 and SHAKE256 extensible-output functions
-#define shake128_init(c) sha3_init(c, 16)
-#define shake256_init(c) sha3_init(c, 32)
+// Multi-buffer hashing: n independent messages, each to its own md, run
+// side by side on the multi-state kernels. Any mix of lengths.
+typedef struct {
+    const void *in;
+    size_t inlen;
+    void *md;
+} sha3_job_t;
+
+int sha3_batch(const sha3_job_t *jobs, size_t n, int mdlen);
+
+// digests of mid || jobs[i].in, mid a SHA3 context that absorbed a shared
+// prefix (not finalized, left unchanged). Output length is mid's mdlen.
+int sha3_batch_suffix(const sha3_ctx_t *mid, const sha3_job_t *jobs,
+    size_t n);
+
+// SHA3-256 of exactly 32 or 64 bytes, one permutation each. The batch
+// forms take n inputs back to back and write n digests back to back.
+void sha3_256_32B(void *md, const void *in);
+void sha3_256_64B(void *md, const void *in);
+void sha3_256_32B_batch(void *md, const void *in, size_t n);
+void sha3_256_64B_batch(void *md, const void *in, size_t n);
+
+// hash chain: md = SHA3-256 applied n times to the 32 bytes at in. The
+// batch form runs count independent chains side by side, the inputs and
+// outputs back to back.
+void sha3_256_chain(void *md, const void *in, uint64_t n);
+void sha3_256_chain_batch(void *md, const void *in, size_t count,
+    uint64_t n);
+
+// SHAKE128 and SHAKE256 extensible-output functions; the context pads
+// as SHAKE only when set up by shake_init()
+int shake_init(sha3_ctx_t *c, int mdlen);   // mdlen = security level / 4
+#define shake128_init(c) shake_init(c, 16)
+#define shake256_init(c) shake_init(c, 32)
 #define shake_update sha3_update
 
 void shake_xof(sha3_ctx_t *c);
 void shake_out(sha3_ctx_t *c, void *out, size_t len);
 
+// TurboSHAKE128 and TurboSHAKE256 (RFC 9861): SHAKE on 12 rounds, with a
+// domain separation byte 0x01..0x7F given at the end of the input
+#define turboshake128_init(c) shake_init(c, 16)
+#define turboshake256_init(c) shake_init(c, 32)
+
+void turboshake_update(sha3_ctx_t *c, const void *data, size_t len);
+void turboshake_xof(sha3_ctx_t *c, uint8_t ds);
+void turboshake_out(sha3_ctx_t *c, void *out, size_t len);
+
+// KangarooTwelve (KT128, RFC 9861) of in with customization string cust.
+// Leaves of 8 KiB are hashed on the multi-state kernels, spread over
+// nthreads threads (0: one per online CPU). Returns 0 if out of memory.
+int kangarootwelve(const void *in, size_t inlen, const void *cust,
+    size_t clen, void *out, size_t outlen, int nthreads);
+
+// NIST SP 800-185, bits = 128 or 256. Inputs go in with sha3_update();
+// the XOF forms are read with shake_out(). Init returns 0 for bad bits.
+// cSHAKE with empty n and s is SHAKE, and pads as such.
+int cshake_init(sha3_ctx_t *c, int bits, const void *n, size_t nlen,
+    const void *s, size_t slen);
+void cshake_xof(sha3_ctx_t *c);
+
+int kmac_init(sha3_ctx_t *c, int bits, const void *key, size_t klen,
+    const void *s, size_t slen);
+void kmac_final(sha3_ctx_t *c, void *mac, size_t len);
+void kmac_xof(sha3_ctx_t *c);               // KMACXOF
+
+int tuplehash_init(sha3_ctx_t *c, int bits, const void *s, size_t slen);
+void tuplehash_add(sha3_ctx_t *c, const void *x, size_t len);  // one item
+void tuplehash_final(sha3_ctx_t *c, void *out, size_t len);
+void tuplehash_xof(sha3_ctx_t *c);          // TupleHashXOF
+
+// ParallelHash of in with block size b, the blocks spread over nthreads
+// threads (0: one per online CPU) and the multi-state kernels. xof != 0
+// gives ParallelHashXOF. Returns 0 for bad bits or b, or out of memory.
+int parallelhash(int bits, const void *in, size_t inlen, size_t b,
+    const void *s, size_t slen, void *out, size_t outlen, int xof,
+    int nthreads);
+
+// squeeze len bytes from each of n <= SHA3_MAX_WAYS contexts in parallel;
+// needs the same rate and position in all of them to run side by side
+void shake_out_multi(sha3_ctx_t *const c[], void *const out[], int n,
+    size_t len);
+
+// Keccak PRNG: eight SHAKE128 streams, SHAKE128(seed || k) for k = 0..7,
+// squeezed on the 8-way kernel. fill() hands out one rate block of each
+// stream in turn; fork() seeds a child from the parent's output.
+typedef struct {
+    uint64_t v[SHA3_MAX_WAYS * 25];         // interleaved stream states
+    uint8_t buf[SHA3_MAX_WAYS * 168];       // current output round
+    size_t pos;                             // bytes of buf used
+} sha3_prng_t;
+
+void sha3_prng_init(sha3_prng_t *g, const void *seed, size_t len);
+void sha3_prng_fill(sha3_prng_t *g, void *buf, size_t n);
+void sha3_prng_fork(sha3_prng_t *child, sha3_prng_t *parent);
+
+// overlapped read and hash of one large input: a reader thread fills a
+// ring of aligned buffers while the caller absorbs them. update() takes
+// everything from fd into c; file() gives the SHA3 digest of path, with
+// SHA3_STREAM_DIRECT to bypass the page cache where the file system
+// allows it. Return 0 on a read error. Stalls count the times a stage
+// had to wait for the other one.
+#define SHA3_STREAM_DIRECT  1
+
+typedef struct {
+    uint64_t bytes;                         // absorbed
+    uint64_t read_stalls, hash_stalls;      // waits: ring full, ring empty
+    double read_stall_s, hash_stall_s;      // time spent in them
+    double total_s;
+} sha3_stream_stats_t;
+
+int sha3_stream_update(sha3_ctx_t *c, int fd, sha3_stream_stats_t *stats);
+int sha3_stream_file(const char *path, void *md, int mdlen, int flags,
+    sha3_stream_stats_t *stats);
+
+// incremental Merkle tree: a leaf is SHA3-256 of 0x00 and its chunk, a
+// node SHA3-256 of 0x01 and its two children; the root binds the top node
+// to the file and chunk sizes.
+// The nodes are kept in the cache file (NULL: none) and reused while its
+// file and chunk sizes match; the caller names the ranges written since
+// with sha3_merkle_dirty(), and root() hashes only those leaves and their
+// paths up, leaves over nthreads threads (0: one per online CPU). open()
+// and root() return 0 on I/O errors or out of memory.
+typedef struct {
+    int fd;
+    const uint8_t *map;                     // the file, mapped shared
+    uint64_t size;
+    size_t chunk;
+    int nthreads;
+    int levels;                             // leaves are level 0
+    uint64_t width[64], off[64];            // nodes per level, first node
+    uint64_t nnodes;
+    uint8_t *node;                          // 32 bytes per node
+    uint8_t *dirty;                         // per leaf
+    uint64_t ndirty;
+    char *cache;
+} sha3_merkle_t;
+
+int sha3_merkle_open(sha3_merkle_t *t, const char *path, const char *cache,
+    size_t chunk, int nthreads);
+void sha3_merkle_dirty(sha3_merkle_t *t, uint64_t off, uint64_t len);
+int sha3_merkle_root(sha3_merkle_t *t, void *md);
+void sha3_merkle_close(sha3_merkle_t *t);
+
+// CPU nonce search with the semantics of hash_nonce() in the HLS model:
+// sha3_mine_hash() is the first 32 bits (little-endian) of SHA3-256 of the
+// 4-byte nonce. sha3_mine() looks at count nonces from start, wrapping at
+// 2^32, over nthreads threads (0: one per online CPU) and returns 1 with
+// the first nonce found whose hash is below target, or 0. sha3_mine_job()
+// below is the same search over a header template.
+#define SHA3_MINE_MAXTHREADS 64
+
+typedef struct {
+    uint64_t hashes;                        // all threads
+    double seconds;                         // wall clock
+    int nthreads;
+    uint64_t steals;                        // ranges split by idle threads
+    uint64_t thread_hashes[SHA3_MINE_MAXTHREADS];
+    double thread_seconds[SHA3_MINE_MAXTHREADS];
+} sha3_mine_stats_t;
+
+uint32_t sha3_mine_hash(uint32_t nonce);
+
+// the same for 4, 8 or 64 consecutive nonces from base on the multi-state
+// and bitsliced kernels: bit k of mask is set when base + k hashes below
+// target. hash receives the values unless NULL.
+void sha3_mine_hash_x4(uint32_t base, uint32_t target, uint32_t *mask,
+    uint32_t hash[4]);
+void sha3_mine_hash_x8(uint32_t base, uint32_t target, uint32_t *mask,
+    uint32_t hash[8]);
+void sha3_mine_hash_x64(uint32_t base, uint32_t target, uint64_t *mask,
+    uint32_t hash[64]);
+int sha3_mine(uint32_t start, uint64_t count, uint32_t target, int nthreads,
+    uint32_t *nonce, sha3_mine_stats_t *st);
+
+// the search kernels start from a round-1 midstate: Theta, Rho and Pi of
+// the first round applied to the block with the nonce bytes zero. A nonce
+// XORs into lane "lane" at bit "shift" (the top spills into lane + 1 when
+// shift > 32); through Theta that reaches only the lanes in aff, so those
+// are all a nonce changes before the first Chi.
+typedef struct {
+    uint64_t b[25];                         // after Pi, native lanes
+    uint32_t aff;                           // bit i: lane i before Pi
+    int lane, shift;
+    uint64_t st[25];                        // the block, for scalar hashing
+} sha3_mine_r1_t;
+
+// mining a header template: the 4-byte nonce goes little-endian at byte
+// nonce_off and the hash is the first 32 bits of SHA3-256 of the whole
+// header. the rate blocks before the last are absorbed once, by
+// sha3_mine_job_init(), which fails unless the nonce lies in the last
+// (padded) block; that block is all that varies between nonces.
+typedef struct {
+    int off;                                // of the nonce in the last block
+    sha3_mine_r1_t r1;                      // r1.st: midstate ^ last block,
+                                            // padded, nonce bytes zero
+} sha3_mine_job_t;
+
+int sha3_mine_job_init(sha3_mine_job_t *job, const void *hdr, size_t len,
+    size_t nonce_off);
+uint32_t sha3_mine_job_hash(const sha3_mine_job_t *job, uint32_t nonce);
+int sha3_mine_job(const sha3_mine_job_t *job, uint32_t start, uint64_t count,
+    uint32_t target, int nthreads, uint32_t *nonce, sha3_mine_stats_t *st);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
 
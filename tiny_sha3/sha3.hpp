@@ -0,0 +1,349 @@
+// sha3.hpp
+// Header-only C++17 wrapper: Sha3<224/256/384/512> and Shake<128/256>.
+// Rate and padding are compile-time constants and every member is
+// constexpr, so digests of literals can be computed by the compiler:
+//
+//   constexpr auto tag = tiny_sha3::Sha3<256>::hash("protocol v1");
+//
+// At run time the permutation is sha3_keccakf(), i.e. the fastest backend
+// picked by the dispatcher. No allocation; hash objects are move-only
+// (use clone() to fork a midstate). The namespace is tiny_sha3 since the
+// C API already has a function named sha3.
+
+#ifndef SHA3_HPP
+#define SHA3_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include "sha3.h"
+
+namespace tiny_sha3 {
+
+namespace detail {
+
+constexpr bool is_constant_evaluated() noexcept
+{
+#if defined(__cpp_lib_is_constant_evaluated)
+    return std::is_constant_evaluated();
+#else
+    return __builtin_is_constant_evaluated();
+#endif
+}
+
+constexpr uint64_t rotl64(uint64_t x, int y)
+{
+    return (x << y) | (x >> ((64 - y) & 63));
+}
+
+// the table-driven reference permutation of sha3.c, on native lanes
+
+constexpr void keccakf(uint64_t st[25])
+{
+    constexpr uint64_t rndc[24] = {
+        0x0000000000000001, 0x0000000000008082, 0x800000000000808a,
+        0x8000000080008000, 0x000000000000808b, 0x0000000080000001,
+        0x8000000080008081, 0x8000000000008009, 0x000000000000008a,
+        0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
+        0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+        0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+        0x000000000000800a, 0x800000008000000a, 0x8000000080008081,
+        0x8000000000008080, 0x0000000080000001, 0x8000000080008008
+    };
+    constexpr int rotc[24] = {
+        1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
+        27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44
+    };
+    constexpr int piln[24] = {
+        10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
+        15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1
+    };
+    uint64_t bc[5] = {}, t = 0;
+
+    for (int r = 0; r < KECCAKF_ROUNDS; r++) {
+
+        // Theta
+        for (int i = 0; i < 5; i++)
+            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+
+        for (int i = 0; i < 5; i++) {
+            t = bc[(i + 4) % 5] ^ rotl64(bc[(i + 1) % 5], 1);
+            for (int j = 0; j < 25; j += 5)
+                st[j + i] ^= t;
+        }
+
+        // Rho Pi
+        t = st[1];
+        for (int i = 0; i < 24; i++) {
+            int j = piln[i];
+            bc[0] = st[j];
+            st[j] = rotl64(t, rotc[i]);
+            t = bc[0];
+        }
+
+        //  Chi
+        for (int j = 0; j < 25; j += 5) {
+            for (int i = 0; i < 5; i++)
+                bc[i] = st[j + i];
+            for (int i = 0; i < 5; i++)
+                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+        }
+
+        //  Iota
+        st[0] ^= rndc[r];
+    }
+}
+
+// sha3_keccakf() takes lanes in memory (little-endian) byte order
+
+constexpr void permute(uint64_t st[25])
+{
+    if (is_constant_evaluated()) {
+        keccakf(st);
+        return;
+    }
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (int i = 0; i < 25; i++)
+        st[i] = __builtin_bswap64(st[i]);
+    sha3_keccakf(st);
+    for (int i = 0; i < 25; i++)
+        st[i] = __builtin_bswap64(st[i]);
+#else
+    sha3_keccakf(st);
+#endif
+}
+
+// sponge over native lanes; bytes are placed little-endian in each lane.
+// the shift-and-or lane loads compile to plain loads at run time.
+
+template <int Rate, uint8_t Pad>
+class Sponge {
+public:
+    static constexpr int rate = Rate;
+    static constexpr uint8_t pad = Pad;
+
+    constexpr Sponge() = default;
+    Sponge(const Sponge &) = delete;
+    Sponge &operator=(const Sponge &) = delete;
+    constexpr Sponge(Sponge &&) = default;
+    constexpr Sponge &operator=(Sponge &&) = default;
+
+    constexpr void absorb(const uint8_t *in, size_t len)
+    {
+        while (len > 0) {
+            if ((pt_ & 7) == 0 && len >= 8) {
+                uint64_t t = 0;
+                for (int k = 7; k >= 0; k--)
+                    t = (t << 8) | in[k];
+                st_[pt_ >> 3] ^= t;
+                pt_ += 8;
+                in += 8;
+                len -= 8;
+            } else {
+                st_[pt_ >> 3] ^= uint64_t(*in++) << (8 * (pt_ & 7));
+                pt_++;
+                len--;
+            }
+            if (pt_ >= Rate) {
+                permute(st_);
+                pt_ = 0;
+            }
+        }
+    }
+
+    constexpr void finish()
+    {
+        st_[pt_ >> 3] ^= uint64_t(Pad) << (8 * (pt_ & 7));
+        st_[(Rate - 1) >> 3] ^= uint64_t(0x80) << (8 * ((Rate - 1) & 7));
+        permute(st_);
+        pt_ = 0;
+    }
+
+    constexpr void squeeze(uint8_t *out, size_t len)
+    {
+        while (len > 0) {
+            if (pt_ >= Rate) {
+                permute(st_);
+                pt_ = 0;
+            }
+            *out++ = uint8_t(st_[pt_ >> 3] >> (8 * (pt_ & 7)));
+            pt_++;
+            len--;
+        }
+    }
+
+    constexpr void copy_to(Sponge &dst) const
+    {
+        for (int i = 0; i < 25; i++)
+            dst.st_[i] = st_[i];
+        dst.pt_ = pt_;
+    }
+
+private:
+    uint64_t st_[25] = {};
+    int pt_ = 0;
+};
+
+constexpr const uint8_t *bytes(std::string_view s, uint8_t *buf, size_t n)
+{
+    // string_view data is char; copy through uint8_t for constexpr use
+    for (size_t i = 0; i < n; i++)
+        buf[i] = uint8_t(s[i]);
+    return buf;
+}
+
+} // namespace detail
+
+// SHA3-224, SHA3-256, SHA3-384, SHA3-512
+
+template <int Bits>
+class Sha3 {
+    static_assert(Bits == 224 || Bits == 256 || Bits == 384 || Bits == 512,
+        "SHA3 output length must be 224, 256, 384 or 512 bits");
+
+public:
+    static constexpr int mdlen = Bits / 8;
+    static constexpr int rate = 200 - 2 * mdlen;
+    using digest_type = std::array<uint8_t, mdlen>;
+
+    constexpr Sha3() = default;
+
+    constexpr Sha3 &update(const uint8_t *data, size_t len)
+    {
+        sponge_.absorb(data, len);
+        return *this;
+    }
+
+    Sha3 &update(const void *data, size_t len)
+    {
+        return update(static_cast<const uint8_t *>(data), len);
+    }
+
+    constexpr Sha3 &update(std::string_view s)
+    {
+        uint8_t buf[64] = {};
+        while (!s.empty()) {
+            size_t n = s.size() < sizeof(buf) ? s.size() : sizeof(buf);
+            sponge_.absorb(detail::bytes(s, buf, n), n);
+            s.remove_prefix(n);
+        }
+        return *this;
+    }
+
+    constexpr digest_type final()
+    {
+        digest_type md = {};
+        sponge_.finish();
+        sponge_.squeeze(md.data(), md.size());
+        return md;
+    }
+
+    constexpr Sha3 clone() const
+    {
+        Sha3 c;
+        sponge_.copy_to(c.sponge_);
+        return c;
+    }
+
+    static constexpr digest_type hash(std::string_view s)
+    {
+        Sha3 h;
+        h.update(s);
+        return h.final();
+    }
+
+    static digest_type hash(const void *data, size_t len)
+    {
+        Sha3 h;
+        h.update(data, len);
+        return h.final();
+    }
+
+private:
+    detail::Sponge<rate, 0x06> sponge_;
+};
+
+// SHAKE128 and SHAKE256: absorb with update(), then squeeze() any length
+
+template <int Bits>
+class Shake {
+    static_assert(Bits == 128 || Bits == 256,
+        "SHAKE security level must be 128 or 256 bits");
+
+public:
+    static constexpr int rate = 200 - Bits / 4;
+
+    constexpr Shake() = default;
+
+    constexpr Shake &update(const uint8_t *data, size_t len)
+    {
+        sponge_.absorb(data, len);
+        return *this;
+    }
+
+    Shake &update(const void *data, size_t len)
+    {
+        return update(static_cast<const uint8_t *>(data), len);
+    }
+
+    constexpr Shake &update(std::string_view s)
+    {
+        uint8_t buf[64] = {};
+        while (!s.empty()) {
+            size_t n = s.size() < sizeof(buf) ? s.size() : sizeof(buf);
+            sponge_.absorb(detail::bytes(s, buf, n), n);
+            s.remove_prefix(n);
+        }
+        return *this;
+    }
+
+    // the first call ends the input
+    constexpr void squeeze(uint8_t *out, size_t len)
+    {
+        if (!xof_) {
+            sponge_.finish();
+            xof_ = true;
+        }
+        sponge_.squeeze(out, len);
+    }
+
+    void squeeze(void *out, size_t len)
+    {
+        squeeze(static_cast<uint8_t *>(out), len);
+    }
+
+    constexpr Shake clone() const
+    {
+        Shake c;
+        sponge_.copy_to(c.sponge_);
+        c.xof_ = xof_;
+        return c;
+    }
+
+    template <size_t N>
+    static constexpr std::array<uint8_t, N> hash(std::string_view s)
+    {
+        std::array<uint8_t, N> out = {};
+        Shake h;
+        h.update(s);
+        h.squeeze(out.data(), N);
+        return out;
+    }
+
+private:
+    detail::Sponge<rate, 0x1F> sponge_;
+    bool xof_ = false;
+};
+
+using Sha3_224 = Sha3<224>;
+using Sha3_256 = Sha3<256>;
+using Sha3_384 = Sha3<384>;
+using Sha3_512 = Sha3<512>;
+using Shake128 = Shake<128>;
+using Shake256 = Shake<256>;
+
+} // namespace tiny_sha3
+
+#endif
@@ -0,0 +1,235 @@
+// sha3_bi32.c
+// Bit-interleaved Keccak-f[1600] for 32-bit cores. Each lane is split into
+// its even and odd bits, held in two 32-bit words, so that a 64-bit rotate
+// becomes two 32-bit rotates. sha3_keccakf_bi32() converts the lanes on
+// the way in and out, a drop-in replacement for sha3_keccakf(); the sponge
+// keeps the state interleaved over runs of whole blocks instead.
+
+#include <string.h>
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+#define ROTL32(x, y) (((x) << (y)) | ((x) >> ((32 - (y)) & 31)))
+
+// round constants as (even, odd) halves
+
+static const uint32_t keccakp_rndc_bi[24][2] = {
+    { 0x00000001, 0x00000000 }, { 0x00000000, 0x00000089 },
+    { 0x00000000, 0x8000008B }, { 0x00000000, 0x80008080 },
+    { 0x00000001, 0x0000008B }, { 0x00000001, 0x00008000 },
+    { 0x00000001, 0x80008088 }, { 0x00000001, 0x80000082 },
+    { 0x00000000, 0x0000000B }, { 0x00000000, 0x0000000A },
+    { 0x00000001, 0x00008082 }, { 0x00000000, 0x00008003 },
+    { 0x00000001, 0x0000808B }, { 0x00000001, 0x8000000B },
+    { 0x00000001, 0x8000008A }, { 0x00000001, 0x80000081 },
+    { 0x00000000, 0x80000081 }, { 0x00000000, 0x80000008 },
+    { 0x00000000, 0x00000083 }, { 0x00000000, 0x80008003 },
+    { 0x00000001, 0x80008088 }, { 0x00000000, 0x80000088 },
+    { 0x00000001, 0x00008000 }, { 0x00000000, 0x80008082 }
+};
+
+// gather even bits of x into the low half, odd bits into the high half;
+// running the steps backwards undoes it
+
+#define BI_SWAP(x, t, m, n) \
+    t = ((x) ^ ((x) >> (n))) & (m); \
+    x ^= t ^ (t << (n))
+
+static uint32_t unshuffle32(uint32_t x)
+{
+    uint32_t t;
+
+    BI_SWAP(x, t, 0x22222222, 1);
+    BI_SWAP(x, t, 0x0C0C0C0C, 2);
+    BI_SWAP(x, t, 0x00F000F0, 4);
+    BI_SWAP(x, t, 0x0000FF00, 8);
+
+    return x;
+}
+
+static uint32_t shuffle32(uint32_t x)
+{
+    uint32_t t;
+
+    BI_SWAP(x, t, 0x0000FF00, 8);
+    BI_SWAP(x, t, 0x00F000F0, 4);
+    BI_SWAP(x, t, 0x0C0C0C0C, 2);
+    BI_SWAP(x, t, 0x22222222, 1);
+
+    return x;
+}
+
+// lane <-> (even, odd) halves
+
+void sha3_bi32_from_lane(uint32_t eo[2], uint64_t lane)
+{
+    uint32_t lo, hi;
+
+    lo = unshuffle32((uint32_t) lane);
+    hi = unshuffle32((uint32_t) (lane >> 32));
+    eo[0] = (lo & 0x0000FFFF) | (hi << 16);
+    eo[1] = (lo >> 16) | (hi & 0xFFFF0000);
+}
+
+uint64_t sha3_bi32_to_lane(const uint32_t eo[2])
+{
+    uint32_t lo, hi;
+
+    lo = shuffle32((eo[0] & 0x0000FFFF) | (eo[1] << 16));
+    hi = shuffle32((eo[0] >> 16) | (eo[1] & 0xFFFF0000));
+
+    return ((uint64_t) hi << 32) | lo;
+}
+
+// b[j] = rho(a[i] ^ theta); the even half of b comes from half se of a
+// rotated by re, the odd half from half so rotated by ro
+
+#define KECCAK_BI_RP(j, i, se, re, so, ro) \
+    b[0][j] = ROTL32(a[se][i] ^ d[se][(i) % 5], re); \
+    b[1][j] = ROTL32(a[so][i] ^ d[so][(i) % 5], ro)
+
+// rounds r0..23 on the interleaved state: st[2 * i] holds the even bits
+// of lane i, st[2 * i + 1] the odd bits
+
+void sha3_keccakp_bi32(uint32_t st[50], int r0)
+{
+    uint32_t a[2][25], b[2][25], c[2][5], d[2][5];
+    int i, h, r, x, y;
+
+    for (i = 0; i < 25; i++) {
+        a[0][i] = st[2 * i];
+        a[1][i] = st[2 * i + 1];
+    }
+
+    for (r = r0; r < 24; r++) {
+
+        // Theta
+        for (h = 0; h < 2; h++) {
+            for (x = 0; x < 5; x++) {
+                c[h][x] = a[h][x] ^ a[h][x + 5] ^ a[h][x + 10] ^
+                    a[h][x + 15] ^ a[h][x + 20];
+            }
+        }
+        for (x = 0; x < 5; x++) {
+            d[0][x] = c[0][(x + 4) % 5] ^ ROTL32(c[1][(x + 1) % 5], 1);
+            d[1][x] = c[1][(x + 4) % 5] ^ c[0][(x + 1) % 5];
+        }
+
+        // Theta applied, Rho Pi
+        KECCAK_BI_RP( 0,  0, 0,  0, 1,  0);
+        KECCAK_BI_RP( 1,  6, 0, 22, 1, 22);
+        KECCAK_BI_RP( 2, 12, 1, 22, 0, 21);
+        KECCAK_BI_RP( 3, 18, 1, 11, 0, 10);
+        KECCAK_BI_RP( 4, 24, 0,  7, 1,  7);
+        KECCAK_BI_RP( 5,  3, 0, 14, 1, 14);
+        KECCAK_BI_RP( 6,  9, 0, 10, 1, 10);
+        KECCAK_BI_RP( 7, 10, 1,  2, 0,  1);
+        KECCAK_BI_RP( 8, 16, 1, 23, 0, 22);
+        KECCAK_BI_RP( 9, 22, 1, 31, 0, 30);
+        KECCAK_BI_RP(10,  1, 1,  1, 0,  0);
+        KECCAK_BI_RP(11,  7, 0,  3, 1,  3);
+        KECCAK_BI_RP(12, 13, 1, 13, 0, 12);
+        KECCAK_BI_RP(13, 19, 0,  4, 1,  4);
+        KECCAK_BI_RP(14, 20, 0,  9, 1,  9);
+        KECCAK_BI_RP(15,  4, 1, 14, 0, 13);
+        KECCAK_BI_RP(16,  5, 0, 18, 1, 18);
+        KECCAK_BI_RP(17, 11, 0,  5, 1,  5);
+        KECCAK_BI_RP(18, 17, 1,  8, 0,  7);
+        KECCAK_BI_RP(19, 23, 0, 28, 1, 28);
+        KECCAK_BI_RP(20,  2, 0, 31, 1, 31);
+        KECCAK_BI_RP(21,  8, 1, 28, 0, 27);
+        KECCAK_BI_RP(22, 14, 1, 20, 0, 19);
+        KECCAK_BI_RP(23, 15, 1, 21, 0, 20);
+        KECCAK_BI_RP(24, 21, 0,  1, 1,  1);
+
+        // Chi
+        for (h = 0; h < 2; h++) {
+            for (y = 0; y < 25; y += 5) {
+                for (x = 0; x < 5; x++) {
+                    a[h][y + x] = b[h][y + x] ^
+                        (~b[h][y + (x + 1) % 5] & b[h][y + (x + 2) % 5]);
+                }
+            }
+        }
+
+        // Iota
+        a[0][0] ^= keccakp_rndc_bi[r][0];
+        a[1][0] ^= keccakp_rndc_bi[r][1];
+    }
+
+    for (i = 0; i < 25; i++) {
+        st[2 * i] = a[0][i];
+        st[2 * i + 1] = a[1][i];
+    }
+}
+
+// drop-in Keccak-p on lanes in the sha3_keccakf() memory format
+
+void sha3_keccakp_bi32_lanes(uint64_t st[25], int r0)
+{
+    uint32_t eo[50];
+    int i;
+
+    for (i = 0; i < 25; i++)
+        sha3_bi32_from_lane(&eo[2 * i], SHA3_LE64(st[i]));
+    sha3_keccakp_bi32(eo, r0);
+    for (i = 0; i < 25; i++)
+        st[i] = SHA3_LE64(sha3_bi32_to_lane(&eo[2 * i]));
+}
+
+void sha3_keccakf_bi32(uint64_t st[25])
+{
+    sha3_keccakp_bi32_lanes(st, 0);
+}
+
+// whole rate blocks on the interleaved state: the state is converted once
+// per call, each block only in its rate lanes as they go in or come out.
+// rsiz is a multiple of 8; returns the bytes absorbed or squeezed.
+
+size_t sha3_bi32_absorb(uint64_t st[25], const uint8_t *in, size_t len,
+    int rsiz, int r0)
+{
+    uint32_t eo[50], t[2];
+    uint64_t q;
+    size_t n;
+    int i;
+
+    for (i = 0; i < 25; i++)
+        sha3_bi32_from_lane(&eo[2 * i], SHA3_LE64(st[i]));
+    for (n = 0; len - n >= (size_t) rsiz; n += rsiz) {
+        for (i = 0; i < rsiz / 8; i++) {
+            memcpy(&q, in + n + 8 * i, 8);
+            sha3_bi32_from_lane(t, SHA3_LE64(q));
+            eo[2 * i] ^= t[0];
+            eo[2 * i + 1] ^= t[1];
+        }
+        sha3_keccakp_bi32(eo, r0);
+    }
+    for (i = 0; i < 25; i++)
+        st[i] = SHA3_LE64(sha3_bi32_to_lane(&eo[2 * i]));
+
+    return n;
+}
+
+size_t sha3_bi32_squeeze(uint64_t st[25], uint8_t *out, size_t len,
+    int rsiz, int r0)
+{
+    uint32_t eo[50];
+    uint64_t q;
+    size_t n;
+    int i;
+
+    for (i = 0; i < 25; i++)
+        sha3_bi32_from_lane(&eo[2 * i], SHA3_LE64(st[i]));
+    for (n = 0; len - n >= (size_t) rsiz; n += rsiz) {
+        sha3_keccakp_bi32(eo, r0);
+        for (i = 0; i < rsiz / 8; i++) {
+            q = SHA3_LE64(sha3_bi32_to_lane(&eo[2 * i]));
+            memcpy(out + n + 8 * i, &q, 8);
+        }
+    }
+    for (i = 0; i < 25; i++)
+        st[i] = SHA3_LE64(sha3_bi32_to_lane(&eo[2 * i]));
+
+    return n;
+}
@@ -0,0 +1,148 @@
+// sha3_bs64.c
+// Bitsliced Keccak-f[1600] over 64 independent instances. Word
+// bs[64 * i + z] holds bit z of lane i, bit k of the word belonging to
+// instance k. Every rotation is then a renaming of word indices, and
+// Theta, Chi and Iota are plain XOR / AND / NOT over words.
+// Experimental; meant for mass hashing where most lanes are shared.
+
+#include <string.h>
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+// in-place 64x64 bit matrix transpose: bit z of a[k] <-> bit k of a[z]
+
+static void transpose64(uint64_t a[64])
+{
+    int j, k;
+    uint64_t m, t;
+
+    for (j = 32, m = 0x00000000FFFFFFFF; j != 0; j >>= 1, m ^= m << j) {
+        for (k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k] ^= t << j;
+            a[k | j] ^= t;
+        }
+    }
+}
+
+// one lane: v[k] is the lane value of instance k
+
+void sha3_bs64_lane_in(uint64_t bs[64], const uint64_t v[64])
+{
+    memcpy(bs, v, 64 * sizeof(uint64_t));
+    transpose64(bs);
+}
+
+void sha3_bs64_lane_out(uint64_t v[64], const uint64_t bs[64])
+{
+    memcpy(v, bs, 64 * sizeof(uint64_t));
+    transpose64(v);
+}
+
+// same lane value in all 64 instances (shared header lanes)
+
+void sha3_bs64_lane_set(uint64_t bs[64], uint64_t v)
+{
+    int z;
+
+    for (z = 0; z < 64; z++)
+        bs[z] = 0 - ((v >> z) & 1);
+}
+
+// whole states, in the sha3_keccakf() memory format
+
+void sha3_bs64_load(uint64_t bs[25 * 64], uint64_t (*const st)[25])
+{
+    int i, k;
+
+    for (i = 0; i < 25; i++) {
+        for (k = 0; k < 64; k++)
+            bs[64 * i + k] = SHA3_LE64(st[k][i]);
+        transpose64(&bs[64 * i]);
+    }
+}
+
+void sha3_bs64_store(uint64_t (*st)[25], const uint64_t bs[25 * 64])
+{
+    int i, k;
+    uint64_t v[64];
+
+    for (i = 0; i < 25; i++) {
+        sha3_bs64_lane_out(v, &bs[64 * i]);
+        for (k = 0; k < 64; k++)
+            st[k][i] = SHA3_LE64(v[k]);
+    }
+}
+
+// the permutation, rounds r0..23. the word loops vectorize; on x86 the
+// kernel is built for AVX2 and AVX-512 too.
+
+static inline __attribute__((always_inline))
+void keccakp_bs64(uint64_t bs[25 * 64], int r0)
+{
+    uint64_t c[5][64], d[5][64], b[25][64], t;
+    int i, r, x, y, z, n;
+
+    for (r = r0; r < 24; r++) {
+
+        // Theta
+        for (x = 0; x < 5; x++) {
+            for (z = 0; z < 64; z++) {
+                c[x][z] = bs[64 * x + z] ^ bs[64 * (x + 5) + z] ^
+                    bs[64 * (x + 10) + z] ^ bs[64 * (x + 15) + z] ^
+                    bs[64 * (x + 20) + z];
+            }
+        }
+        for (x = 0; x < 5; x++) {
+            d[x][0] = c[(x + 4) % 5][0] ^ c[(x + 1) % 5][63];
+            for (z = 1; z < 64; z++)
+                d[x][z] = c[(x + 4) % 5][z] ^ c[(x + 1) % 5][z - 1];
+        }
+
+        // Theta applied, Rho as an index rename, Pi as a lane rename
+        for (i = 0; i < 25; i++) {
+            x = i % 5;
+            n = 64 - keccakp_rho[i];
+            for (z = 0; z < n; z++)
+                b[keccakp_pi[i]][z + 64 - n] = bs[64 * i + z] ^ d[x][z];
+            for (; z < 64; z++)
+                b[keccakp_pi[i]][z - n] = bs[64 * i + z] ^ d[x][z];
+        }
+
+        // Chi
+        for (y = 0; y < 25; y += 5) {
+            for (x = 0; x < 5; x++) {
+                for (z = 0; z < 64; z++) {
+                    bs[64 * (y + x) + z] = b[y + x][z] ^
+                        (~b[y + (x + 1) % 5][z] & b[y + (x + 2) % 5][z]);
+                }
+            }
+        }
+
+        // Iota: complement the words of the set round constant bits
+        t = keccakp_rndc[r];
+        for (z = 0; z < 64; z++) {
+            if ((t >> z) & 1)
+                bs[z] = ~bs[z];
+        }
+    }
+}
+
+void sha3_keccakp_bs64_generic(uint64_t bs[25 * 64], int r0)
+{
+    keccakp_bs64(bs, r0);
+}
+
+#ifdef SHA3_X86
+__attribute__((target("avx2")))
+void sha3_keccakp_bs64_avx2(uint64_t bs[25 * 64], int r0)
+{
+    keccakp_bs64(bs, r0);
+}
+
+__attribute__((target("avx512f")))
+void sha3_keccakp_bs64_avx512(uint64_t bs[25 * 64], int r0)
+{
+    keccakp_bs64(bs, r0);
+}
+#endif
@@ -0,0 +1,183 @@
+// sha3_chain.c
+// Iterated SHA3-256 of a 32-byte value, H^n(x). Only the four digest lanes
+// carry over from one step to the next, so the loop keeps them in
+// variables and rebuilds the padded block around them from constants; the
+// state never goes through memory. The multi-chain kernels do the same on
+// GCC vector types, one chain per element.
+
+#include <string.h>
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+// padded block of a 32-byte message in lane-complemented form: digest in
+// lanes 0..3, 0x06 in lane 4, 0x80 at the top of lane 16 (rate 136), with
+// the complemented lanes be, bi, go, ki, mi, sa. z is a zero of type T.
+
+#define CHAIN_LOAD(X, d0, d1, d2, d3, z) \
+    X##ba = (d0); X##be = ~(d1); X##bi = ~(d2); X##bo = (d3); \
+    X##bu = (z) + 0x06; X##ga = (z); X##ge = (z); X##gi = (z); \
+    X##go = ~(z); X##gu = (z); X##ka = (z); X##ke = (z); \
+    X##ki = ~(z); X##ko = (z); X##ku = (z); X##ma = (z); \
+    X##me = (z) + 0x8000000000000000; X##mi = ~(z); X##mo = (z); \
+    X##mu = (z); X##sa = ~(z); X##se = (z); X##si = (z); X##so = (z); \
+    X##su = (z)
+
+#define CHAIN_BODY(T, d0, d1, d2, d3, z, n) \
+    KECCAK_DECLARE_T(T, A); \
+    KECCAK_DECLARE_T(T, E); \
+    KECCAK_DECLARE_T(T, B); \
+    KECCAK_DECLARE_CD(T); \
+    for (; (n) > 0; (n)--) { \
+        CHAIN_LOAD(A, d0, d1, d2, d3, z); \
+        KECCAK_ROUNDS_FROM(0); \
+        d0 = Aba; d1 = ~Abe; d2 = ~Abi; d3 = Abo; \
+    }
+
+// scalar, with the unrolled rounds; d holds native lanes
+
+void sha3_chain_unrolled(uint64_t d[4], uint64_t n)
+{
+    uint64_t d0 = d[0], d1 = d[1], d2 = d[2], d3 = d[3];
+    const uint64_t z = 0;
+
+    CHAIN_BODY(uint64_t, d0, d1, d2, d3, z, n);
+
+    d[0] = d0;
+    d[1] = d1;
+    d[2] = d2;
+    d[3] = d3;
+}
+
+// any other scalar backend: rebuild the block in memory each step
+
+void sha3_chain_keccakf(uint64_t d[4], uint64_t n)
+{
+    uint64_t st[25];
+    int i;
+
+    for (; n > 0; n--) {
+        for (i = 0; i < 4; i++)
+            st[i] = SHA3_LE64(d[i]);
+        st[4] = SHA3_LE64((uint64_t) 0x06);
+        for (i = 5; i < 25; i++)
+            st[i] = 0;
+        st[16] = SHA3_LE64((uint64_t) 0x8000000000000000);
+        sha3_impl.keccakf(st);
+        for (i = 0; i < 4; i++)
+            d[i] = SHA3_LE64(st[i]);
+    }
+}
+
+// multi-chain: lane i of chain k at d[i * ways + k]
+
+typedef uint64_t sha3_v4 __attribute__((vector_size(32)));
+typedef uint64_t sha3_v4u __attribute__((vector_size(32), aligned(8)));
+typedef uint64_t sha3_v8 __attribute__((vector_size(64)));
+typedef uint64_t sha3_v8u __attribute__((vector_size(64), aligned(8)));
+
+static inline __attribute__((always_inline))
+void chain_x4(uint64_t d[4 * 4], uint64_t n)
+{
+    sha3_v4 d0 = *(const sha3_v4u *) &d[0];
+    sha3_v4 d1 = *(const sha3_v4u *) &d[4];
+    sha3_v4 d2 = *(const sha3_v4u *) &d[8];
+    sha3_v4 d3 = *(const sha3_v4u *) &d[12];
+    const sha3_v4 z = { 0, 0, 0, 0 };
+
+    CHAIN_BODY(sha3_v4, d0, d1, d2, d3, z, n);
+
+    *(sha3_v4u *) &d[0] = d0;
+    *(sha3_v4u *) &d[4] = d1;
+    *(sha3_v4u *) &d[8] = d2;
+    *(sha3_v4u *) &d[12] = d3;
+}
+
+static inline __attribute__((always_inline))
+void chain_x8(uint64_t d[8 * 4], uint64_t n)
+{
+    sha3_v8 d0 = *(const sha3_v8u *) &d[0];
+    sha3_v8 d1 = *(const sha3_v8u *) &d[8];
+    sha3_v8 d2 = *(const sha3_v8u *) &d[16];
+    sha3_v8 d3 = *(const sha3_v8u *) &d[24];
+    const sha3_v8 z = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    CHAIN_BODY(sha3_v8, d0, d1, d2, d3, z, n);
+
+    *(sha3_v8u *) &d[0] = d0;
+    *(sha3_v8u *) &d[8] = d1;
+    *(sha3_v8u *) &d[16] = d2;
+    *(sha3_v8u *) &d[24] = d3;
+}
+
+void sha3_chain_x4_generic(uint64_t d[4 * 4], uint64_t n)
+{
+    chain_x4(d, n);
+}
+
+#ifdef SHA3_X86
+__attribute__((target("avx2")))
+void sha3_chain_x4_avx2(uint64_t d[4 * 4], uint64_t n)
+{
+    chain_x4(d, n);
+}
+
+__attribute__((target("avx512f")))
+void sha3_chain_x8_avx512(uint64_t d[8 * 4], uint64_t n)
+{
+    chain_x8(d, n);
+}
+#endif
+
+// H^n(in)
+
+void sha3_256_chain(void *md, const void *in, uint64_t n)
+{
+    uint64_t d[4];
+    int i;
+
+    memcpy(d, in, 32);
+    for (i = 0; i < 4; i++)
+        d[i] = SHA3_LE64(d[i]);
+    sha3_impl.chain(d, n);
+    for (i = 0; i < 4; i++)
+        d[i] = SHA3_LE64(d[i]);
+    memcpy(md, d, 32);
+}
+
+// count independent chains, inputs and outputs back to back. groups of
+// the kernel width; a short tail runs as a partial group unless it is one
+
+void sha3_256_chain_batch(void *md, const void *in, size_t count,
+    uint64_t n)
+{
+    const uint8_t *p = (const uint8_t *) in;
+    uint8_t *q = (uint8_t *) md;
+    uint64_t d[SHA3_MAX_WAYS * 4], t;
+    int i, k, m, ways;
+
+    ways = sha3_backend_ways();
+
+    while (count > 1) {
+        m = count < (size_t) ways ? (int) count : ways;
+        memset(d, 0, sizeof(d));
+        for (k = 0; k < m; k++) {
+            for (i = 0; i < 4; i++) {
+                memcpy(&t, p + 32 * k + 8 * i, 8);
+                d[i * ways + k] = SHA3_LE64(t);
+            }
+        }
+        sha3_impl.chainx(d, n);
+        for (k = 0; k < m; k++) {
+            for (i = 0; i < 4; i++) {
+                t = SHA3_LE64(d[i * ways + k]);
+                memcpy(q + 32 * k + 8 * i, &t, 8);
+            }
+        }
+        p += 32 * m;
+        q += 32 * m;
+        count -= m;
+    }
+
+    if (count == 1)
+        sha3_256_chain(q, p, n);
+}
@@ -0,0 +1,500 @@
+// sha3_dispatch.c
+// Binds sha3_keccakf() and the multi-state kernels to the fastest backend
+// the running CPU supports. The CPU is checked once, on the first call
+// through any entry point, under pthread_once() since that call may come
+// from several threads at a time. The SHA3_BACKEND environment variable
+// overrides the choice for A/B benchmarking, see sha3_backend_select().
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+// instruction set levels of the multi-state kernels
+
+enum { SHA3_ISA_GENERIC, SHA3_ISA_AVX2, SHA3_ISA_AVX512, SHA3_ISA_COUNT };
+
+static const char *sha3_isa_name[SHA3_ISA_COUNT] = {
+    "generic", "avx2", "avx512"
+};
+
+// scalar permutations; Keccak-f, Keccak-p from round r0, 12-round Keccak-p
+
+static void keccakp12_ref(uint64_t st[25])
+{
+    sha3_keccakp_ref(st, 12);
+}
+
+static void keccakp12_bi32(uint64_t st[25])
+{
+    sha3_keccakp_bi32_lanes(st, 12);
+}
+
+static const struct {
+    const char *name;
+    void (*keccakf)(uint64_t st[25]);
+    void (*keccakp)(uint64_t st[25], int r0);
+    void (*keccakp12)(uint64_t st[25]);
+    void (*chain)(uint64_t d[4], uint64_t n);
+} sha3_scalar[] = {
+    { "ref",        sha3_keccakf_ref,       sha3_keccakp_ref,
+                    keccakp12_ref,          sha3_chain_keccakf },
+    { "unrolled",   sha3_keccakf_unrolled,  sha3_keccakp_unrolled,
+                    sha3_keccakp12_unrolled, sha3_chain_unrolled },
+    { "bi32",       sha3_keccakf_bi32,      sha3_keccakp_bi32_lanes,
+                    keccakp12_bi32,         sha3_chain_keccakf }
+};
+
+#define SHA3_SCALARS ((int) (sizeof(sha3_scalar) / sizeof(sha3_scalar[0])))
+
+// first calls land here and resolve the table
+
+static void sha3_dispatch_init(void);
+
+static void keccakf_first(uint64_t st[25])
+{
+    sha3_dispatch_init();
+    sha3_impl.keccakf(st);
+}
+
+static void keccakp_first(uint64_t st[25], int r0)
+{
+    sha3_dispatch_init();
+    sha3_impl.keccakp(st, r0);
+}
+
+static void keccakp12_first(uint64_t st[25])
+{
+    sha3_dispatch_init();
+    sha3_impl.keccakp12(st);
+}
+
+static void x4_first(uint64_t st[4 * 25], int r0)
+{
+    sha3_dispatch_init();
+    sha3_impl.x4(st, r0);
+}
+
+static void x8_first(uint64_t st[8 * 25], int r0)
+{
+    sha3_dispatch_init();
+    sha3_impl.x8(st, r0);
+}
+
+static void bs64_first(uint64_t bs[25 * 64], int r0)
+{
+    sha3_dispatch_init();
+    sha3_impl.bs64(bs, r0);
+}
+
+static void chain_first(uint64_t d[4], uint64_t n)
+{
+    sha3_dispatch_init();
+    sha3_impl.chain(d, n);
+}
+
+static void chainx_first(uint64_t *d, uint64_t n)
+{
+    sha3_dispatch_init();
+    sha3_impl.chainx(d, n);
+}
+
+static uint32_t mine4_first(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    sha3_dispatch_init();
+    return sha3_impl.mine4(r1, base, target, h);
+}
+
+static uint32_t mine8_first(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    sha3_dispatch_init();
+    return sha3_impl.mine8(r1, base, target, h);
+}
+
+sha3_impl_t sha3_impl = {
+    keccakf_first, keccakp_first, keccakp12_first,
+    x4_first, x8_first, bs64_first, chain_first, chainx_first,
+    mine4_first, mine8_first
+};
+
+static pthread_once_t sha3_once = PTHREAD_ONCE_INIT;
+static int sha3_cpu_isa;                    // best level the CPU supports
+static int sha3_cur_scalar, sha3_cur_isa, sha3_cur_ways;
+
+static int cpu_isa(void)
+{
+#ifdef SHA3_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SHA3_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SHA3_ISA_AVX2;
+#endif
+    return SHA3_ISA_GENERIC;
+}
+
+// scalar default: the build can force the reference; 32-bit targets
+// prefer the bit-interleaved code
+
+static int default_scalar(void)
+{
+#if defined(SHA3_KECCAKF_REF) || KECCAKF_ROUNDS != 24
+    return 0;
+#elif UINTPTR_MAX <= 0xFFFFFFFF
+    return 2;
+#else
+    return 1;
+#endif
+}
+
+#if KECCAKF_ROUNDS != 24
+
+// reduced-round builds: Keccak-f is rounds 0 .. KECCAKF_ROUNDS - 1, which
+// no multi-state kernel runs (they run r0..23). r0 == 0 on the x4, x8 and
+// bs64 slots stands for Keccak-f, so those calls go a state at a time
+// through the scalar permutation; Keccak-p from r0 > 0 keeps the kernels.
+// chains and nonce search are Keccak-f only and go the scalar way too.
+
+static void (*kern_x4)(uint64_t st[4 * 25], int r0);
+static void (*kern_x8)(uint64_t st[8 * 25], int r0);
+static void (*kern_bs64)(uint64_t bs[25 * 64], int r0);
+
+static void keccakf_ways(uint64_t *v, int ways)
+{
+    uint64_t st[25];
+    int i, k;
+
+    for (k = 0; k < ways; k++) {
+        for (i = 0; i < 25; i++)
+            st[i] = SHA3_LE64(v[i * ways + k]);
+        sha3_impl.keccakf(st);
+        for (i = 0; i < 25; i++)
+            v[i * ways + k] = SHA3_LE64(st[i]);
+    }
+}
+
+static void x4_reduced(uint64_t st[4 * 25], int r0)
+{
+    if (r0 == 0)
+        keccakf_ways(st, 4);
+    else
+        kern_x4(st, r0);
+}
+
+static void x8_reduced(uint64_t st[8 * 25], int r0)
+{
+    if (r0 == 0)
+        keccakf_ways(st, 8);
+    else
+        kern_x8(st, r0);
+}
+
+static void bs64_reduced(uint64_t bs[25 * 64], int r0)
+{
+    uint64_t st[64][25];
+    int i, k;
+
+    if (r0 != 0) {
+        kern_bs64(bs, r0);
+        return;
+    }
+    sha3_bs64_store(st, bs);
+    for (k = 0; k < 64; k++) {
+        for (i = 0; i < 25; i++)
+            st[k][i] = SHA3_LE64(st[k][i]);
+        sha3_impl.keccakf(st[k]);
+        for (i = 0; i < 25; i++)
+            st[k][i] = SHA3_LE64(st[k][i]);
+    }
+    sha3_bs64_load(bs, st);
+}
+
+static void chainx_reduced(uint64_t *d, uint64_t n)
+{
+    uint64_t t[4];
+    int i, k, ways;
+
+    ways = sha3_cur_ways;
+    for (k = 0; k < ways; k++) {
+        for (i = 0; i < 4; i++)
+            t[i] = d[i * ways + k];
+        sha3_impl.chain(t, n);
+        for (i = 0; i < 4; i++)
+            d[i * ways + k] = t[i];
+    }
+}
+
+static uint32_t mine_reduced(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h, int ways)
+{
+    uint64_t st[25];
+    uint32_t x, hv, m;
+    int i, k;
+
+    m = 0;
+    for (k = 0; k < ways; k++) {
+        x = base + k;
+        memcpy(st, r1->st, sizeof(st));
+        st[r1->lane] ^= (uint64_t) x << r1->shift;
+        if (r1->shift > 32)
+            st[r1->lane + 1] ^= (uint64_t) x >> (64 - r1->shift);
+        for (i = 0; i < 25; i++)
+            st[i] = SHA3_LE64(st[i]);
+        sha3_impl.keccakf(st);
+        hv = (uint32_t) SHA3_LE64(st[0]);
+        m |= (uint32_t) (hv < target) << k;
+        if (h != NULL)
+            h[k] = hv;
+    }
+
+    return m;
+}
+
+static uint32_t mine4_reduced(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    return mine_reduced(r1, base, target, h, 4);
+}
+
+static uint32_t mine8_reduced(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    return mine_reduced(r1, base, target, h, 8);
+}
+
+#endif
+
+static void bind(int scalar, int isa)
+{
+    sha3_impl.keccakf = sha3_scalar[scalar].keccakf;
+    sha3_impl.keccakp = sha3_scalar[scalar].keccakp;
+    sha3_impl.keccakp12 = sha3_scalar[scalar].keccakp12;
+    sha3_impl.chain = sha3_scalar[scalar].chain;
+    sha3_impl.x4 = sha3_keccakp_x4_generic;
+    sha3_impl.x8 = sha3_keccakp_x8_generic;
+    sha3_impl.bs64 = sha3_keccakp_bs64_generic;
+    sha3_impl.chainx = sha3_chain_x4_generic;
+    sha3_impl.mine4 = sha3_mine_x4_generic;
+    sha3_impl.mine8 = sha3_mine_x8_generic;
+    sha3_cur_ways = 4;
+
+#ifdef SHA3_X86
+    if (isa >= SHA3_ISA_AVX2) {
+        sha3_impl.x4 = sha3_keccakp_x4_avx2;
+        sha3_impl.x8 = sha3_keccakp_x8_avx2;
+        sha3_impl.bs64 = sha3_keccakp_bs64_avx2;
+        sha3_impl.chainx = sha3_chain_x4_avx2;
+        sha3_impl.mine4 = sha3_mine_x4_avx2;
+        sha3_impl.mine8 = sha3_mine_x8_avx2;
+    }
+    if (isa >= SHA3_ISA_AVX512) {
+        sha3_impl.x8 = sha3_keccakp_x8_avx512;
+        sha3_impl.bs64 = sha3_keccakp_bs64_avx512;
+        sha3_impl.chainx = sha3_chain_x8_avx512;
+        sha3_impl.mine8 = sha3_mine_x8_avx512;
+        sha3_cur_ways = 8;
+    }
+#endif
+
+#if KECCAKF_ROUNDS != 24
+    kern_x4 = sha3_impl.x4;
+    kern_x8 = sha3_impl.x8;
+    kern_bs64 = sha3_impl.bs64;
+    sha3_impl.x4 = x4_reduced;
+    sha3_impl.x8 = x8_reduced;
+    sha3_impl.bs64 = bs64_reduced;
+    sha3_impl.chainx = chainx_reduced;
+    sha3_impl.mine4 = mine4_reduced;
+    sha3_impl.mine8 = mine8_reduced;
+#endif
+
+    sha3_cur_scalar = scalar;
+    sha3_cur_isa = isa;
+}
+
+// comma-separated list of a scalar name and/or an instruction set level
+// onto *scalar and *isa. levels the CPU lacks are refused. returns 1 if
+// every item was applied.
+
+// only the reference follows KECCAKF_ROUNDS; the others always run 24
+// rounds, so a reduced-round build refuses them rather than change digests
+
+static int scalar_ok(int i)
+{
+    return i == 0 || KECCAKF_ROUNDS == 24;
+}
+
+static int parse(const char *spec, int *scalar, int *isa)
+{
+    char tok[16];
+    size_t n;
+    int i, ok, found;
+
+    ok = 1;
+    while (*spec != 0) {
+        n = strcspn(spec, ",");
+        found = 0;
+        if (n < sizeof(tok)) {
+            memcpy(tok, spec, n);
+            tok[n] = 0;
+            for (i = 0; i < SHA3_SCALARS; i++) {
+                if (strcmp(tok, sha3_scalar[i].name) == 0 &&
+                    scalar_ok(i)) {
+                    *scalar = i;
+                    found = 1;
+                }
+            }
+            for (i = 0; i < SHA3_ISA_COUNT; i++) {
+                if (strcmp(tok, sha3_isa_name[i]) == 0 &&
+                    i <= sha3_cpu_isa) {
+                    *isa = i;
+                    found = 1;
+                }
+            }
+        }
+        if (!found)
+            ok = 0;
+        spec += n;
+        if (*spec == ',')
+            spec++;
+    }
+
+    return ok;
+}
+
+// the first binding, the environment override included, in one step so
+// no thread sees the default while it is replaced
+
+static void dispatch_once(void)
+{
+    const char *env;
+    int scalar, isa;
+
+    sha3_cpu_isa = cpu_isa();
+    scalar = default_scalar();
+    isa = sha3_cpu_isa;
+    env = getenv("SHA3_BACKEND");
+    if (env != NULL && *env != 0)
+        parse(env, &scalar, &isa);
+    bind(scalar, isa);
+}
+
+static void sha3_dispatch_init(void)
+{
+    pthread_once(&sha3_once, dispatch_once);
+}
+
+// rebind on top of the current binding
+
+int sha3_backend_select(const char *spec)
+{
+    int ok, scalar, isa;
+
+    sha3_dispatch_init();
+    scalar = sha3_cur_scalar;
+    isa = sha3_cur_isa;
+    ok = parse(spec, &scalar, &isa);
+    bind(scalar, isa);
+
+    return ok;
+}
+
+// "scalar,isa" of the current binding; sha3_backend_select() accepts it
+
+const char *sha3_backend_name(void)
+{
+    static char name[32];
+
+    sha3_dispatch_init();
+    strcpy(name, sha3_scalar[sha3_cur_scalar].name);
+    strcat(name, ",");
+    strcat(name, sha3_isa_name[sha3_cur_isa]);
+
+    return name;
+}
+
+int sha3_backend_ways(void)
+{
+    sha3_dispatch_init();
+    return sha3_cur_ways;
+}
+
+// dispatched entry points
+
+void sha3_keccakf(uint64_t st[25])
+{
+    sha3_impl.keccakf(st);
+}
+
+void sha3_keccakf_x4(uint64_t st[4 * 25])
+{
+    sha3_impl.x4(st, 0);
+}
+
+void sha3_keccakf_x8(uint64_t st[8 * 25])
+{
+    sha3_impl.x8(st, 0);
+}
+
+void sha3_keccakf_bs64(uint64_t bs[25 * 64])
+{
+    sha3_impl.bs64(bs, 0);
+}
+
+// Keccak-p[1600, nrounds]. the common round counts go straight to their
+// specialized code; others enter the unrolled sequence part way
+
+void keccak_p1600(uint64_t st[25], int nrounds)
+{
+    if (nrounds < 1 || nrounds > 24)
+        return;
+
+    switch (nrounds) {
+#if KECCAKF_ROUNDS == 24
+        case 24:
+            sha3_impl.keccakf(st);
+            break;
+#endif
+        case 12:
+            sha3_impl.keccakp12(st);
+            break;
+        default:
+            sha3_impl.keccakp(st, 24 - nrounds);
+            break;
+    }
+}
+
+void keccak_p1600_12(uint64_t st[25])
+{
+    sha3_impl.keccakp12(st);
+}
+
+// a reduced-round build binds the slots to the Keccak-f wrappers above;
+// all 24 rounds are then the kernel's
+
+void keccak_p1600_x4(uint64_t st[4 * 25], int nrounds)
+{
+    if (nrounds < 1 || nrounds > 24)
+        return;
+#if KECCAKF_ROUNDS != 24
+    sha3_dispatch_init();
+    kern_x4(st, 24 - nrounds);
+#else
+    sha3_impl.x4(st, 24 - nrounds);
+#endif
+}
+
+void keccak_p1600_x8(uint64_t st[8 * 25], int nrounds)
+{
+    if (nrounds < 1 || nrounds > 24)
+        return;
+#if KECCAKF_ROUNDS != 24
+    sha3_dispatch_init();
+    kern_x8(st, 24 - nrounds);
+#else
+    sha3_impl.x8(st, 24 - nrounds);
+#endif
+}
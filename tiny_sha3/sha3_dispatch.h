@@ -0,0 +1,83 @@
+// sha3_dispatch.h
+// Internal: ISA-specific builds of the permutation kernels and the table
+// the dispatcher binds them through. Multi-state kernels run rounds r0..23;
+// through the table, r0 == 0 is Keccak-f, whatever KECCAKF_ROUNDS is.
+
+#ifndef SHA3_DISPATCH_H
+#define SHA3_DISPATCH_H
+
+#include "sha3.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA3_X86
+#endif
+
+// scalar Keccak-p, rounds r0..23
+void sha3_keccakp_ref(uint64_t st[25], int r0);
+void sha3_keccakp_unrolled(uint64_t st[25], int r0);
+void sha3_keccakp12_unrolled(uint64_t st[25]);
+void sha3_keccakp_bi32_lanes(uint64_t st[25], int r0);
+
+// sponge runs of whole rate blocks through the bit-interleaved state,
+// Keccak-p from round r0; the bytes done
+size_t sha3_bi32_absorb(uint64_t st[25], const uint8_t *in, size_t len,
+    int rsiz, int r0);
+size_t sha3_bi32_squeeze(uint64_t st[25], uint8_t *out, size_t len,
+    int rsiz, int r0);
+
+// H^n chains of SHA3-256 on native digest lanes; multi-chain kernels take
+// lane i of chain k at d[i * ways + k], 4 or 8 ways
+void sha3_chain_unrolled(uint64_t d[4], uint64_t n);
+void sha3_chain_keccakf(uint64_t d[4], uint64_t n);
+void sha3_chain_x4_generic(uint64_t d[4 * 4], uint64_t n);
+
+// round-1 midstate (sha3_mine_r1_t in sha3.h) of a block with the nonce
+// bytes zero and the nonce at byte off
+void sha3_mine_r1_init(sha3_mine_r1_t *r1, const uint64_t st[25], int off);
+
+// hash_nonce() of 4 or 8 consecutive nonces: hashes to h unless NULL,
+// returns the mask of those below target
+typedef uint32_t (*sha3_mine_fn)(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h);
+
+uint32_t sha3_mine_x4_generic(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h);
+uint32_t sha3_mine_x8_generic(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h);
+
+void sha3_keccakp_x4_generic(uint64_t st[4 * 25], int r0);
+void sha3_keccakp_x8_generic(uint64_t st[8 * 25], int r0);
+void sha3_keccakp_bs64_generic(uint64_t bs[25 * 64], int r0);
+
+#ifdef SHA3_X86
+void sha3_keccakp_x4_avx2(uint64_t st[4 * 25], int r0);
+void sha3_keccakp_x8_avx2(uint64_t st[8 * 25], int r0);
+void sha3_keccakp_x8_avx512(uint64_t st[8 * 25], int r0);
+void sha3_keccakp_bs64_avx2(uint64_t bs[25 * 64], int r0);
+void sha3_keccakp_bs64_avx512(uint64_t bs[25 * 64], int r0);
+void sha3_chain_x4_avx2(uint64_t d[4 * 4], uint64_t n);
+void sha3_chain_x8_avx512(uint64_t d[8 * 4], uint64_t n);
+uint32_t sha3_mine_x4_avx2(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h);
+uint32_t sha3_mine_x8_avx2(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h);
+uint32_t sha3_mine_x8_avx512(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h);
+#endif
+
+// currently bound implementations; resolved on first call
+typedef struct {
+    void (*keccakf)(uint64_t st[25]);
+    void (*keccakp)(uint64_t st[25], int r0);
+    void (*keccakp12)(uint64_t st[25]);
+    void (*x4)(uint64_t st[4 * 25], int r0);
+    void (*x8)(uint64_t st[8 * 25], int r0);
+    void (*bs64)(uint64_t bs[25 * 64], int r0);
+    void (*chain)(uint64_t d[4], uint64_t n);
+    void (*chainx)(uint64_t *d, uint64_t n);   // sha3_backend_ways() wide
+    sha3_mine_fn mine4, mine8;
+} sha3_impl_t;
+
+extern sha3_impl_t sha3_impl;
+
+#endif
@@ -0,0 +1,110 @@
+// sha3_fixed.c
+// One-shot SHA3-256 of exactly 32 or 64 bytes (hash of a hash, Merkle
+// nodes, nonces). The message always fits the first block, so the padded
+// block is built lane by lane and permuted once; no context, no byte-wise
+// update or padding.
+
+#include <string.h>
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+#define FIXED_MDLANES   4                   // SHA3-256 digest
+#define FIXED_LASTLANE  16                  // rate 136 bytes = 17 lanes
+
+// padded block of nl input lanes, in native byte order for the kernels
+
+static void fixed_block(uint64_t st[25], const uint8_t *in, int nl)
+{
+    uint64_t t;
+    int i;
+
+    for (i = 0; i < nl; i++) {
+        memcpy(&t, in + 8 * i, 8);
+        st[i] = SHA3_LE64(t);
+    }
+    st[nl] = 0x06;
+    for (i = nl + 1; i < 25; i++)
+        st[i] = 0;
+    st[FIXED_LASTLANE] ^= 0x8000000000000000;
+}
+
+static void fixed_digest(uint8_t *md, const uint64_t *st, int step)
+{
+    uint64_t t;
+    int i;
+
+    for (i = 0; i < FIXED_MDLANES; i++) {
+        t = SHA3_LE64(st[i * step]);
+        memcpy(md + 8 * i, &t, 8);
+    }
+}
+
+// single message: the block is built in sha3_keccakf() byte order
+
+static void fixed1(uint8_t *md, const uint8_t *in, int nl)
+{
+    uint64_t st[25];
+    int i;
+
+    memcpy(st, in, 8 * nl);
+    st[nl] = SHA3_LE64((uint64_t) 0x06);
+    for (i = nl + 1; i < 25; i++)
+        st[i] = 0;
+    st[FIXED_LASTLANE] ^= SHA3_LE64((uint64_t) 0x8000000000000000);
+    sha3_keccakf(st);
+    memcpy(md, st, 8 * FIXED_MDLANES);
+}
+
+// n inputs of nl lanes each, back to back; digests likewise. groups of
+// the kernel width, the tail as a partial group unless it is one message
+
+static void fixed_batch(uint8_t *md, const uint8_t *in, size_t n, int nl)
+{
+    uint64_t v[SHA3_MAX_WAYS * 25] __attribute__((aligned(64)));
+    uint64_t st[25];
+    int i, k, m, ways;
+
+    ways = sha3_backend_ways();
+
+    while (n > 1) {
+        m = n < (size_t) ways ? (int) n : ways;
+        memset(v, 0, sizeof(v));
+        for (k = 0; k < m; k++) {
+            fixed_block(st, in + 8 * nl * k, nl);
+            for (i = 0; i < 25; i++)
+                v[i * ways + k] = st[i];
+        }
+        if (ways == 8)
+            sha3_impl.x8(v, 0);
+        else
+            sha3_impl.x4(v, 0);
+        for (k = 0; k < m; k++)
+            fixed_digest(md + 8 * FIXED_MDLANES * k, v + k, ways);
+        in += 8 * nl * m;
+        md += 8 * FIXED_MDLANES * m;
+        n -= m;
+    }
+
+    if (n == 1)
+        fixed1(md, in, nl);
+}
+
+void sha3_256_32B(void *md, const void *in)
+{
+    fixed1((uint8_t *) md, (const uint8_t *) in, 4);
+}
+
+void sha3_256_64B(void *md, const void *in)
+{
+    fixed1((uint8_t *) md, (const uint8_t *) in, 8);
+}
+
+void sha3_256_32B_batch(void *md, const void *in, size_t n)
+{
+    fixed_batch((uint8_t *) md, (const uint8_t *) in, n, 4);
+}
+
+void sha3_256_64B_batch(void *md, const void *in, size_t n)
+{
+    fixed_batch((uint8_t *) md, (const uint8_t *) in, n, 8);
+}
@@ -7,88 +7,124 @@
 #include "sha3_hls.h"
 
 
-void sha3_keccakf_hls(uint64_t state[25])
+// Keccak constants
+static const uint64_t keccakf_rndc[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+static const int keccakf_rotc[24] = {
+    1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
+    27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44
+};
+
+static const int keccakf_piln[24] = {
+    10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
+    15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1
+};
+
+// One Keccak-f round
+static void keccakf_round_hls(uint64_t state[25], int r)
 {
-    #pragma HLS INLINE off
-    #pragma HLS ARRAY_PARTITION variable=state complete dim=1
-    
-    // Keccak constants
-    static const uint64_t keccakf_rndc[24] = {
-        0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
-        0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
-        0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
-        0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
-        0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
-        0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
-        0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
-        0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
-    };
+    #pragma HLS INLINE
     #pragma HLS RESOURCE variable=keccakf_rndc core=ROM_1P_BRAM
-
-    static const int keccakf_rotc[24] = {
-        1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
-        27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44
-    };
     #pragma HLS RESOURCE variable=keccakf_rotc core=ROM_1P_BRAM
-
-    static const int keccakf_piln[24] = {
-        10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
-        15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1
-    };
     #pragma HLS RESOURCE variable=keccakf_piln core=ROM_1P_BRAM
 
     uint64_t t, bc[5];
     #pragma HLS ARRAY_PARTITION variable=bc complete dim=1
 
-    // Keccak-f rounds
-    ROUND_LOOP: for (int r = 0; r < KECCAKF_ROUNDS; r++) {
-        #pragma HLS PIPELINE off
-        
-        // Theta columns
-        THETA_1: for (int i = 0; i < 5; i++) {
+    // Theta columns
+    THETA_1: for (int i = 0; i < 5; i++) {
+        #pragma HLS UNROLL
+        bc[i] = state[i] ^ state[i + 5] ^ state[i + 10] ^ state[i + 15] ^ state[i + 20];
+    }
+
+    // Theta rows
+    THETA_2: for (int i = 0; i < 5; i++) {
+        #pragma HLS UNROLL
+        t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
+        state[i]      ^= t;
+        state[i + 5]  ^= t; 
+        state[i + 10] ^= t;
+        state[i + 15] ^= t;
+        state[i + 20] ^= t;
+    }
+
+    t = state[1];
+    RHO_PI: for (int i = 0; i < 24; i++) {
+        #pragma HLS PIPELINE II=1
+        int j = keccakf_piln[i];
+        bc[0] = state[j];
+        state[j] = ROTL64(t, keccakf_rotc[i]);
+        t = bc[0];
+    }
+
+    // Chi (unrolled for all 5 rows)
+    CHI_ROW: for (int row = 0; row < 5; row++) {
+        #pragma HLS UNROLL
+        int base = row * 5;
+        for (int i = 0; i < 5; i++) {
             #pragma HLS UNROLL
-            bc[i] = state[i] ^ state[i + 5] ^ state[i + 10] ^ state[i + 15] ^ state[i + 20];
+            bc[i] = state[base + i];
         }
-        
-        // Theta rows
-        THETA_2: for (int i = 0; i < 5; i++) {
+        for (int i = 0; i < 5; i++) {
             #pragma HLS UNROLL
-            t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
-            state[i]      ^= t;
-            state[i + 5]  ^= t; 
-            state[i + 10] ^= t;
-            state[i + 15] ^= t;
-            state[i + 20] ^= t;
+            state[base + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
         }
+    }
 
-        t = state[1];
-        RHO_PI: for (int i = 0; i < 24; i++) {
-            #pragma HLS PIPELINE II=1
-            int j = keccakf_piln[i];
-            bc[0] = state[j];
-            state[j] = ROTL64(t, keccakf_rotc[i]);
-            t = bc[0];
-        }
+    // Iota
+    state[0] ^= keccakf_rndc[r];
+}
 
-        // Chi (unrolled for all 5 rows)
-        CHI_ROW: for (int row = 0; row < 5; row++) {
-            #pragma HLS UNROLL
-            int base = row * 5;
-            for (int i = 0; i < 5; i++) {
-                #pragma HLS UNROLL
-                bc[i] = state[base + i];
-            }
-            for (int i = 0; i < 5; i++) {
-                #pragma HLS UNROLL
-                state[base + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
-            }
-        }
+void sha3_keccakf_hls(uint64_t state[25])
+{
+    #pragma HLS INLINE off
+    #pragma HLS ARRAY_PARTITION variable=state complete dim=1
 
-        // Iota
-        state[0] ^= keccakf_rndc[r];
+    // Keccak-f rounds
+    ROUND_LOOP: for (int r = 0; r < KECCAKF_ROUNDS; r++) {
+        #pragma HLS PIPELINE off
+        keccakf_round_hls(state, r);
     }
 }
 
+// Keccak-f for when only lane 0 of the result is read (the miner compares
+// 32 bits of it). The last round computes lane 0 alone: Theta for columns
+// 0..2, and of Rho/Pi/Chi only the three lanes that land in row 0, x = 0..2
+// (lanes 0, 6 and 12). The other lanes are left as they were before it.
+void sha3_keccakf_hls_lane0(uint64_t state[25])
+{
+    #pragma HLS INLINE off
+    #pragma HLS ARRAY_PARTITION variable=state complete dim=1
+
+    uint64_t bc[5], b0, b1, b2;
+    #pragma HLS ARRAY_PARTITION variable=bc complete dim=1
+
+    ROUND_LOOP: for (int r = 0; r < KECCAKF_ROUNDS - 1; r++) {
+        #pragma HLS PIPELINE off
+        keccakf_round_hls(state, r);
+    }
+
+    THETA_1: for (int i = 0; i < 5; i++) {
+        #pragma HLS UNROLL
+        bc[i] = state[i] ^ state[i + 5] ^ state[i + 10] ^ state[i + 15] ^ state[i + 20];
+    }
+    b0 = state[0] ^ bc[4] ^ ROTL64(bc[1], 1);
+    b1 = state[6] ^ bc[0] ^ ROTL64(bc[2], 1);
+    b2 = state[12] ^ bc[1] ^ ROTL64(bc[3], 1);
+    b1 = ROTL64(b1, 44);
+    b2 = ROTL64(b2, 43);
+    state[0] = b0 ^ ((~b1) & b2) ^ keccakf_rndc[KECCAKF_ROUNDS - 1];
+}
+
 // Hash a nonce (adder-hasher component)
 void hash_nonce(uint32_t nonce, uint32_t *hash_output, bool *valid)
 {
@@ -104,16 +140,86 @@ void hash_nonce(uint32_t nonce, uint32_t *hash_output, bool *valid)
         state[i] = 0;
     }
     
-    // Absorb nonce (simplified - just place nonce in first word)
-    // Real mining include block header + nonce
-    // For sake of demonstration we ignore it here
+    // Absorb nonce: the message is the bare nonce; hash_nonce_job()
+    // takes a block header template around it
     state[0] ^= (uint64_t)nonce;
     
     // Apply padding for SHA-3 
     state[0] ^= 0x06ULL << 32;  // Domain separation  
     state[(SHA3_256_RATE/8) - 1] ^= 0x8000000000000000ULL;
     
-    sha3_keccakf_hls(state);
+    sha3_keccakf_hls_lane0(state);
+    
+    // Extract first 32 bits of hash for comparison
+    *hash_output = (uint32_t)(state[0] & 0xFFFFFFFFULL);
+    *valid = true;
+}
+
+// Build a mining job from a header template (host side, once per job).
+// Full rate blocks before the last are absorbed here; the last block is
+// XORed over the midstate with its padding and the nonce bytes left out.
+bool mining_job_init(mining_job_t *job, const uint8_t *header, uint32_t len,
+                     uint32_t nonce_off)
+{
+    uint32_t last = len - len % SHA3_256_RATE;
+    
+    // Nonce must be in the last block; a header filling whole blocks
+    // would put the padding in a block of its own
+    if (len < 4 || nonce_off < last || nonce_off > len - 4) {
+        return false;
+    }
+    
+    for (int i = 0; i < 25; i++) {
+        job->state[i] = 0;
+    }
+    
+    // Midstate: absorb the blocks before the last
+    for (uint32_t blk = 0; blk < last; blk += SHA3_256_RATE) {
+        for (int i = 0; i < SHA3_256_RATE; i++) {
+            job->state[i / 8] ^= (uint64_t)header[blk + i] << (8 * (i % 8));
+        }
+        sha3_keccakf_hls(job->state);
+    }
+    
+    // Last block without the nonce, then padding
+    for (uint32_t i = last; i < len; i++) {
+        if (i >= nonce_off && i < nonce_off + 4) {
+            continue;
+        }
+        job->state[(i - last) / 8] ^= (uint64_t)header[i] << (8 * ((i - last) % 8));
+    }
+    job->state[(len - last) / 8] ^= 0x06ULL << (8 * ((len - last) % 8));
+    job->state[(SHA3_256_RATE/8) - 1] ^= 0x8000000000000000ULL;
+    
+    job->nonce_off = nonce_off - last;
+    return true;
+}
+
+// Hash a nonce within a job (adder-hasher component)
+void hash_nonce_job(const mining_job_t *job, uint32_t nonce,
+                    uint32_t *hash_output, bool *valid)
+{
+    #pragma HLS INLINE off
+    #pragma HLS PIPELINE off
+    
+    uint64_t state[25];
+    #pragma HLS ARRAY_PARTITION variable=state complete dim=1
+    
+    LOAD_STATE: for (int i = 0; i < 25; i++) {
+        #pragma HLS UNROLL
+        state[i] = job->state[i];
+    }
+    
+    // Nonce at byte nonce_off; it spills into the next lane when it
+    // starts in the top three bytes of one
+    uint32_t lane = job->nonce_off / 8;
+    uint32_t shift = 8 * (job->nonce_off % 8);
+    state[lane] ^= (uint64_t)nonce << shift;
+    if (shift > 32) {
+        state[lane + 1] ^= (uint64_t)nonce >> (64 - shift);
+    }
+    
+    sha3_keccakf_hls_lane0(state);
     
     // Extract first 32 bits of hash for comparison
     *hash_output = (uint32_t)(state[0] & 0xFFFFFFFFULL);
@@ -136,6 +242,7 @@ uint32_t increment_nonce(uint32_t current_nonce)
 
 // Desynchronized mining pipeline
 void mining_pipeline(
+    const mining_job_t *job,
     uint32_t initial_nonce,
     uint32_t target,
     bool start_mining,
@@ -183,7 +290,7 @@ void mining_pipeline(
     // Hash current nonce 
     uint32_t hash_result;
     bool hash_valid;
-    hash_nonce(current_nonce, &hash_result, &hash_valid);
+    hash_nonce_job(job, current_nonce, &hash_result, &hash_valid);
     
     if (hash_valid) {
         // Insert into pipeline
@@ -216,8 +323,13 @@ void mining_pipeline(
     *hash_count = total_hashes;
 }
 
-// Top-level mining controller (AXI-Lite interface)
+// Top-level mining controller (AXI-Lite interface). The job registers sit
+// at fixed offsets above the control ones: the nonce offset at 0x80, the
+// 25 state lanes at 0x100 (two 32-bit words a lane, low word first). A
+// host that hashes bare nonces writes the mining_job_init(hdr, 4, 0) job.
 void sha3_miner_top(
+    const uint64_t control_job_state[25],
+    uint32_t control_job_nonce_off,
     uint32_t *control_start,
     uint32_t *control_stop, 
     uint32_t *control_status,
@@ -229,6 +341,8 @@ void sha3_miner_top(
 )
 {
 
+    #pragma HLS INTERFACE mode=s_axilite port=control_job_nonce_off bundle=control offset=0x80
+    #pragma HLS INTERFACE mode=s_axilite port=control_job_state bundle=control offset=0x100
     #pragma HLS INTERFACE mode=s_axilite port=control_start bundle=control offset=0x00
     #pragma HLS INTERFACE mode=s_axilite port=control_stop bundle=control offset=0x04
     #pragma HLS INTERFACE mode=s_axilite port=control_status bundle=control offset=0x08
@@ -252,8 +366,20 @@ void sha3_miner_top(
     uint32_t initial_nonce = *control_initial_nonce;
     uint32_t target_hash = *control_target_hash;
     
+    // Job from its registers; the nonce has to fit in the rate block
+    mining_job_t job;
+    LOAD_JOB: for (int i = 0; i < 25; i++) {
+        #pragma HLS UNROLL
+        job.state[i] = control_job_state[i];
+    }
+    job.nonce_off = control_job_nonce_off;
+    bool job_valid = control_job_nonce_off <= SHA3_256_RATE - 4;
+    
     // State machine
-    if (start_requested && miner_status == 0) {
+    if (start_requested && miner_status == 0 && !job_valid) {
+        miner_status = 3;
+        *control_start = 0;
+    } else if (start_requested && miner_status == 0) {
         miner_status = 1;
         mining_active = true;
         hash_counter = 0;
@@ -272,6 +398,7 @@ void sha3_miner_top(
         uint64_t current_hash_count;
         
         mining_pipeline(
+            &job,
             initial_nonce,
             target_hash,
             true,
@@ -44,16 +44,36 @@ typedef struct {
     int      valid;             // Indicates if buffer contains valid data
 } hash_result_t;
 
+// Mining job: a block header template with the 4-byte nonce (little-endian)
+// at a byte offset. The rate blocks before the last are absorbed once by
+// mining_job_init() into the midstate; state holds that midstate XOR the
+// padded last block with the nonce bytes zero, so only the nonce changes
+// per hash. The nonce has to lie in the last block.
+typedef struct {
+    uint64_t state[25];
+    uint32_t nonce_off;       // byte offset of the nonce in the last block
+} mining_job_t;
+
 // Fixed-size message processing (HLS-friendly)
 void sha3_keccakf_hls(uint64_t state[25]);
 
+// Keccak-f with only lane 0 valid afterwards (last round pruned)
+void sha3_keccakf_hls_lane0(uint64_t state[25]);
+
 void hash_nonce(uint32_t nonce, uint32_t *hash_output, bool *valid);
 
+bool mining_job_init(mining_job_t *job, const uint8_t *header, uint32_t len,
+                     uint32_t nonce_off);
+
+void hash_nonce_job(const mining_job_t *job, uint32_t nonce,
+                    uint32_t *hash_output, bool *valid);
+
 bool compare_hash(uint32_t hash_value, uint32_t target);
 
 uint32_t increment_nonce(uint32_t current_nonce);
 
 void mining_pipeline(
+    const mining_job_t *job,
     uint32_t initial_nonce,
     uint32_t target,
     bool start_mining,
@@ -63,7 +83,9 @@ void mining_pipeline(
 );
 
 void sha3_miner_top(
-    // AXI-Lite control interface
+    // AXI-Lite control interface; job at 0x80 (nonce offset), 0x100 (state)
+    const uint64_t control_job_state[25],
+    uint32_t control_job_nonce_off,
     uint32_t *control_start,
     uint32_t *control_stop, 
     uint32_t *control_status,
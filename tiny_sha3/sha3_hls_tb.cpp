@@ -13,6 +13,9 @@
 // Include your header
 #include "sha3_hls.h"
 
+// Job whose header is the bare nonce (what hash_nonce() hashes)
+static mining_job_t nonce_job;
+
 // Test utilities
 void print_state(const char* test_name, uint32_t status, uint32_t result_nonce, uint64_t hash_count) {
     const char* status_str[] = {"IDLE", "RUNNING", "FOUND", "STOPPED"};
@@ -121,6 +124,7 @@ void test_mining_pipeline_easy() {
     
     for (int iter = 0; iter < max_iterations && !found_solution; iter++) {
         mining_pipeline(
+            &nonce_job,
             initial_nonce,
             target,
             true,
@@ -165,7 +169,8 @@ void test_axi_interface() {
     uint32_t control_hash_count_high = 0;
     
     printf("Step 1: Check initial idle state\n");
-    sha3_miner_top(&control_start, &control_stop, &control_status,
+    sha3_miner_top(nonce_job.state, nonce_job.nonce_off,
+                   &control_start, &control_stop, &control_status,
                    &control_initial_nonce, &control_target_hash,
                    &control_result_nonce, &control_hash_count_low, &control_hash_count_high);
     
@@ -179,7 +184,8 @@ void test_axi_interface() {
     // Run for multiple cycles to simulate mining
     int max_cycles = 2000;
     for (int cycle = 0; cycle < max_cycles; cycle++) {
-        sha3_miner_top(&control_start, &control_stop, &control_status,
+        sha3_miner_top(nonce_job.state, nonce_job.nonce_off,
+                       &control_start, &control_stop, &control_status,
                        &control_initial_nonce, &control_target_hash,
                        &control_result_nonce, &control_hash_count_low, &control_hash_count_high);
         
@@ -214,7 +220,8 @@ void test_axi_interface() {
     if (control_status == 1) { // Still running
         printf("\nStep 3: Stop mining (timeout after %d cycles)\n", max_cycles);
         control_stop = 1;
-        sha3_miner_top(&control_start, &control_stop, &control_status,
+        sha3_miner_top(nonce_job.state, nonce_job.nonce_off,
+                       &control_start, &control_stop, &control_status,
                        &control_initial_nonce, &control_target_hash,
                        &control_result_nonce, &control_hash_count_low, &control_hash_count_high);
         
@@ -250,7 +257,8 @@ void test_stress_easy_target() {
         control_initial_nonce = run * 1000; // Different starting point each run
         
         for (int cycle = 0; cycle < 2000; cycle++) {
-            sha3_miner_top(&control_start, &control_stop, &control_status,
+            sha3_miner_top(nonce_job.state, nonce_job.nonce_off,
+                           &control_start, &control_stop, &control_status,
                            &control_initial_nonce, &control_target_hash,
                            &control_result_nonce, &control_hash_count_low, &control_hash_count_high);
             
@@ -273,7 +281,8 @@ void test_stress_easy_target() {
         control_stop = 0;
         // Run a few more cycles to reset internal state
         for (int i = 0; i < 5; i++) {
-            sha3_miner_top(&control_start, &control_stop, &control_status,
+            sha3_miner_top(nonce_job.state, nonce_job.nonce_off,
+                           &control_start, &control_stop, &control_status,
                            &control_initial_nonce, &control_target_hash,
                            &control_result_nonce, &control_hash_count_low, &control_hash_count_high);
         }
@@ -282,11 +291,145 @@ void test_stress_easy_target() {
     printf("\nStress test results: %d/%d solutions found\n", found_solutions, max_runs);
 }
 
+// Reference: SHA3-256 of a whole message, block by block
+static uint32_t ref_hash(const uint8_t *msg, uint32_t len) {
+    uint64_t state[25] = {0};
+    uint32_t i, j = 0;
+    
+    for (i = 0; i < len; i++) {
+        state[j / 8] ^= (uint64_t)msg[i] << (8 * (j % 8));
+        if (++j == SHA3_256_RATE) {
+            sha3_keccakf_hls(state);
+            j = 0;
+        }
+    }
+    state[j / 8] ^= 0x06ULL << (8 * (j % 8));
+    state[(SHA3_256_RATE/8) - 1] ^= 0x8000000000000000ULL;
+    sha3_keccakf_hls(state);
+    return (uint32_t)state[0];
+}
+
+// Test 7: Header template jobs
+void test_header_job() {
+    printf("\n=== Test 7: Header Template Jobs ===\n");
+    
+    const uint32_t lens[] = {4, 80, 213, 300, 407};
+    const uint32_t offs[] = {0, 76, 205, 290, 403};
+    uint8_t header[408];
+    mining_job_t job;
+    bool pass = true;
+    
+    for (int i = 0; i < 408; i++) {
+        header[i] = (uint8_t)(i * 0x9D + 0x5B);
+    }
+    
+    for (int t = 0; t < 5; t++) {
+        if (!mining_job_init(&job, header, lens[t], offs[t])) {
+            printf("Job init (len %u, nonce at %u): FAIL\n", lens[t], offs[t]);
+            pass = false;
+            continue;
+        }
+        int bad = 0;
+        for (uint32_t nonce = 0x12345670; nonce < 0x12345770; nonce++) {
+            uint32_t hash;
+            bool valid;
+            for (int k = 0; k < 4; k++) {
+                header[offs[t] + k] = (uint8_t)(nonce >> (8 * k));
+            }
+            hash_nonce_job(&job, nonce, &hash, &valid);
+            if (!valid || hash != ref_hash(header, lens[t])) {
+                bad++;
+            }
+        }
+        printf("Header %u bytes, nonce at %u: %s\n", lens[t], offs[t],
+               bad == 0 ? "PASS" : "FAIL");
+        pass = pass && bad == 0;
+    }
+    
+    // The bare-nonce job is hash_nonce()
+    for (uint32_t nonce = 0; nonce < 256; nonce++) {
+        uint32_t h1, h2;
+        bool v1, v2;
+        hash_nonce(nonce, &h1, &v1);
+        hash_nonce_job(&nonce_job, nonce, &h2, &v2);
+        pass = pass && h1 == h2;
+    }
+    
+    // Nonce outside the last block
+    bool rejected = !mining_job_init(&job, header, 136, 100) &&
+                    !mining_job_init(&job, header, 140, 134) &&
+                    !mining_job_init(&job, header, 140, 137);
+    printf("Job rejection: %s\n", rejected ? "PASS" : "FAIL");
+    
+    // Mine a 300-byte header
+    mining_job_init(&job, header, 300, 290);
+    bool found = false;
+    uint32_t solution_nonce = 0;
+    uint64_t hash_count = 0;
+    for (int iter = 0; iter < 1000 && !found; iter++) {
+        mining_pipeline(&job, 0, 0x80000000, true, &found, &solution_nonce,
+                        &hash_count);
+    }
+    uint32_t verify_hash = 0;
+    bool valid = false;
+    if (found) {
+        hash_nonce_job(&job, solution_nonce, &verify_hash, &valid);
+    }
+    bool mined = found && valid && compare_hash(verify_hash, 0x80000000);
+    printf("Header mining: %s (Nonce: 0x%08X, Hash: 0x%08X)\n",
+           mined ? "PASS" : "FAIL", solution_nonce, verify_hash);
+    
+    printf("Header template jobs: %s\n", pass && rejected && mined ? "PASS" : "FAIL");
+}
+
+// Test 8: Job registers. The drivers write the bare-nonce job as constants;
+// they must match mining_job_init(). A nonce offset past the rate block
+// must not start the miner.
+void test_job_registers() {
+    printf("\n=== Test 8: Job Registers ===\n");
+    
+    uint64_t state[25] = {0};
+    state[0] = 0x06ULL << 32;
+    state[16] = 0x8000000000000000ULL;
+    
+    bool same = nonce_job.nonce_off == 0;
+    for (int i = 0; i < 25; i++) {
+        same = same && nonce_job.state[i] == state[i];
+    }
+    printf("Driver default job: %s\n", same ? "PASS" : "FAIL");
+    
+    uint32_t control_start = 1;
+    uint32_t control_stop = 0;
+    uint32_t control_status = 0;
+    uint32_t control_initial_nonce = 0;
+    uint32_t control_target_hash = 0xFFFFFFFF;
+    uint32_t control_result_nonce = 0;
+    uint32_t control_hash_count_low = 0;
+    uint32_t control_hash_count_high = 0;
+    
+    sha3_miner_top(state, SHA3_256_RATE - 3,
+                   &control_start, &control_stop, &control_status,
+                   &control_initial_nonce, &control_target_hash,
+                   &control_result_nonce, &control_hash_count_low, &control_hash_count_high);
+    bool refused = control_status == 3 && control_start == 0;
+    
+    // back to idle once acknowledged
+    sha3_miner_top(state, 0,
+                   &control_start, &control_stop, &control_status,
+                   &control_initial_nonce, &control_target_hash,
+                   &control_result_nonce, &control_hash_count_low, &control_hash_count_high);
+    refused = refused && control_status == 0;
+    printf("Bad nonce offset: %s\n", refused ? "PASS" : "FAIL");
+}
+
 int main() {
     printf("=======================================================\n");
     printf("SHA3 Miner HLS Testbench\n");
     printf("=======================================================\n");
     
+    const uint8_t bare[4] = {0};
+    mining_job_init(&nonce_job, bare, sizeof(bare), 0);
+    
     // Run all tests
     test_keccakf();
     test_single_hash();
@@ -294,6 +437,8 @@ int main() {
     test_mining_pipeline_easy();
     test_axi_interface();
     test_stress_easy_target();
+    test_header_job();
+    test_job_registers();
     
     printf("\n=======================================================\n");
     printf("All tests completed. Check results above.\n");
@@ -0,0 +1,96 @@
+// sha3_k12.c
+// KangarooTwelve (KT128, RFC 9861). The input S = M || C || length_encode(|C|)
+// is cut into 8 KiB chunks. Chunks 1..n-1 are leaves, hashed to 32-byte
+// chaining values with TurboSHAKE128(., 0x0B) as multi-buffer jobs on the
+// 12-round multi-state kernels, in contiguous ranges over threads.
+// The final node absorbs chunk 0, the chaining values and the leaf count.
+
+#include <stdlib.h>
+#include <string.h>
+#include "sha3_mb.h"
+
+#define K12_CHUNK       8192
+#define K12_CV          32
+
+// length_encode(x): big-endian bytes of x without leading zeros, then
+// their count
+
+static size_t k12_lenc(uint8_t *buf, size_t x)
+{
+    size_t i, n;
+
+    for (n = 0; n < sizeof(size_t) && (x >> (8 * n)) != 0; n++)
+        ;
+    for (i = 0; i < n; i++)
+        buf[i] = (uint8_t) (x >> (8 * (n - 1 - i)));
+    buf[n] = (uint8_t) n;
+
+    return n + 1;
+}
+
+int kangarootwelve(const void *in, size_t inlen, const void *cust,
+    size_t clen, void *out, size_t outlen, int nthreads)
+{
+    const uint8_t *m = (const uint8_t *) in;
+    const uint8_t pad[8] = { 0x03, 0, 0, 0, 0, 0, 0, 0 };
+    const uint8_t ff[2] = { 0xFF, 0xFF };
+    const sha3_mb_param_t leaf = { 168, K12_CV, 12, 0x0B, NULL, 0 };
+    uint8_t enc[sizeof(size_t) + 1], nenc[sizeof(size_t) + 1];
+    sha3_job_t *jobs;
+    sha3_ctx_t c;
+    uint8_t *tail, *cv;
+    size_t elen, slen, nleaves, i, i0, off;
+
+    elen = k12_lenc(enc, clen);
+    slen = inlen + clen + elen;
+
+    turboshake128_init(&c);
+    if (slen <= K12_CHUNK) {
+        turboshake_update(&c, in, inlen);
+        turboshake_update(&c, cust, clen);
+        turboshake_update(&c, enc, elen);
+        turboshake_xof(&c, 0x07);
+        turboshake_out(&c, out, outlen);
+        return 1;
+    }
+
+    // chunks from i0 on reach into C, so they are copied out once
+    nleaves = (slen - 1) / K12_CHUNK;
+    i0 = inlen / K12_CHUNK;
+    off = K12_CHUNK * i0;
+    tail = (uint8_t *) malloc(slen - off);
+    jobs = (sha3_job_t *) malloc(nleaves * sizeof(sha3_job_t));
+    cv = (uint8_t *) malloc(nleaves * K12_CV);
+    if (tail == NULL || jobs == NULL || cv == NULL) {
+        free(tail);
+        free(jobs);
+        free(cv);
+        return 0;
+    }
+    memcpy(tail, m + off, inlen - off);
+    memcpy(tail + inlen - off, cust, clen);
+    memcpy(tail + inlen - off + clen, enc, elen);
+
+    for (i = 1; i <= nleaves; i++) {
+        jobs[i - 1].in = i < i0 ? m + K12_CHUNK * i :
+            tail + K12_CHUNK * (i - i0);
+        jobs[i - 1].inlen = i < nleaves ? K12_CHUNK : slen - K12_CHUNK * i;
+        jobs[i - 1].md = cv + K12_CV * (i - 1);
+    }
+    sha3_mb_hash_mt(&leaf, jobs, nleaves, nthreads);
+
+    // final node
+    turboshake_update(&c, i0 > 0 ? m : tail, K12_CHUNK);
+    turboshake_update(&c, pad, sizeof(pad));
+    turboshake_update(&c, cv, nleaves * K12_CV);
+    turboshake_update(&c, nenc, k12_lenc(nenc, nleaves));
+    turboshake_update(&c, ff, sizeof(ff));
+    turboshake_xof(&c, 0x06);
+    turboshake_out(&c, out, outlen);
+
+    free(tail);
+    free(jobs);
+    free(cv);
+
+    return 1;
+}
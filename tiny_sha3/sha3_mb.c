@@ -0,0 +1,304 @@
+// sha3_mb.c
+// Multi-buffer hashing: independent messages share the multi-state
+// permutation kernels, one message per lane. The states stay interleaved
+// for the whole batch. A lane that finishes its message is refilled with
+// the next one right away, so messages of any length mix freely; lanes are
+// only masked (run without a message) once the batch drains.
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+#include "sha3_mb.h"
+
+// XOR one rate block into lane k of an interleaved state
+
+static void mb_xor_block(uint64_t *v, int ways, int k,
+    const uint8_t *in, int rsiz)
+{
+    uint64_t t;
+    int i;
+
+    for (i = 0; i < rsiz / 8; i++) {
+        memcpy(&t, in + 8 * i, 8);
+        v[i * ways + k] ^= SHA3_LE64(t);
+    }
+}
+
+// partial block: len bytes at byte offset off, padded if this is the last
+
+static void mb_xor_part(uint64_t *v, int ways, int k, int off,
+    const uint8_t *in, size_t len, int pad, const sha3_mb_param_t *p)
+{
+    uint8_t blk[200];
+
+    memset(blk, 0, p->rsiz);
+    memcpy(blk + off, in, len);
+    if (pad) {
+        blk[off + len] ^= p->ds;
+        blk[p->rsiz - 1] ^= 0x80;
+    }
+    mb_xor_block(v, ways, k, blk, p->rsiz);
+}
+
+// start lane k from the initial value
+
+static void mb_lane_init(uint64_t *v, int ways, int k,
+    const sha3_mb_param_t *p)
+{
+    int i;
+
+    for (i = 0; i < 25; i++)
+        v[i * ways + k] = p->iv != NULL ? p->iv[i] : 0;
+}
+
+static void mb_digest(void *md, const uint64_t *v, int ways, int k,
+    int mdlen)
+{
+    uint64_t t[25];
+    int i;
+
+    for (i = 0; i < (mdlen + 7) / 8; i++)
+        t[i] = SHA3_LE64(v[i * ways + k]);
+    memcpy(md, t, mdlen);
+}
+
+// scalar permutation on native lanes (no-op conversions on little-endian)
+
+static void mb_permute1(uint64_t st[25], int nrounds)
+{
+    int i;
+
+    for (i = 0; i < 25; i++)
+        st[i] = SHA3_LE64(st[i]);
+    if (nrounds == 24)
+        sha3_keccakf(st);                   // as the multi-state r0 == 0
+    else
+        keccak_p1600(st, nrounds);
+    for (i = 0; i < 25; i++)
+        st[i] = SHA3_LE64(st[i]);
+}
+
+// one message on the scalar permutation
+
+static void mb_single(const sha3_mb_param_t *p, const sha3_job_t *job)
+{
+    uint64_t st[25];
+    const uint8_t *in = (const uint8_t *) job->in;
+    size_t len = job->inlen;
+    size_t m;
+    int off = p->pt;
+
+    mb_lane_init(st, 1, 0, p);
+    for (m = p->rsiz - off; len >= m; m = p->rsiz) {
+        if (off == 0)
+            mb_xor_block(st, 1, 0, in, p->rsiz);
+        else
+            mb_xor_part(st, 1, 0, off, in, m, 0, p);
+        mb_permute1(st, p->nrounds);
+        in += m;
+        len -= m;
+        off = 0;
+    }
+    mb_xor_part(st, 1, 0, off, in, len, 1, p);
+    mb_permute1(st, p->nrounds);
+    mb_digest(job->md, st, 1, 0, p->mdlen);
+}
+
+void sha3_mb_hash(const sha3_mb_param_t *p, const sha3_job_t *jobs, size_t n)
+{
+    uint64_t v[SHA3_MAX_WAYS * 25] __attribute__((aligned(64)));
+    const sha3_job_t *job[SHA3_MAX_WAYS];
+    const uint8_t *in[SHA3_MAX_WAYS];
+    size_t left[SHA3_MAX_WAYS], next, m;
+    int last[SHA3_MAX_WAYS], off[SHA3_MAX_WAYS];
+    int k, ways, active, r0;
+
+    if (n <= 1) {
+        if (n == 1)
+            mb_single(p, jobs);
+        return;
+    }
+
+    ways = sha3_backend_ways();
+    r0 = 24 - p->nrounds;
+    memset(v, 0, sizeof(v));
+
+    next = 0;
+    active = 0;
+    for (k = 0; k < ways; k++) {
+        job[k] = NULL;
+        if (next < n) {
+            job[k] = &jobs[next++];
+            in[k] = (const uint8_t *) job[k]->in;
+            left[k] = job[k]->inlen;
+            off[k] = p->pt;
+            mb_lane_init(v, ways, k, p);
+            active++;
+        }
+    }
+
+    while (active > 0) {
+
+        // next block of every lane that has a message
+        for (k = 0; k < ways; k++) {
+            if (job[k] == NULL)
+                continue;
+            m = p->rsiz - off[k];
+            last[k] = left[k] < m;
+            if (last[k]) {
+                mb_xor_part(v, ways, k, off[k], in[k], left[k], 1, p);
+            } else {
+                if (off[k] == 0)
+                    mb_xor_block(v, ways, k, in[k], p->rsiz);
+                else
+                    mb_xor_part(v, ways, k, off[k], in[k], m, 0, p);
+                in[k] += m;
+                left[k] -= m;
+                off[k] = 0;
+            }
+        }
+
+        if (ways == 8)
+            sha3_impl.x8(v, r0);
+        else
+            sha3_impl.x4(v, r0);
+
+        // retire finished lanes and refill them
+        for (k = 0; k < ways; k++) {
+            if (job[k] == NULL || !last[k])
+                continue;
+            mb_digest(job[k]->md, v, ways, k, p->mdlen);
+            mb_lane_init(v, ways, k, p);
+            job[k] = NULL;
+            if (next < n) {
+                job[k] = &jobs[next++];
+                in[k] = (const uint8_t *) job[k]->in;
+                left[k] = job[k]->inlen;
+                off[k] = p->pt;
+            } else {
+                active--;
+            }
+        }
+    }
+}
+
+// threaded: contiguous ranges of jobs, the calling thread takes the first.
+// a range whose thread does not start runs on the caller.
+
+#define MB_MAXTHREADS   64
+#define MB_MINBYTES     (1 << 18)           // per thread
+
+typedef struct {
+    const sha3_mb_param_t *p;
+    const sha3_job_t *jobs;
+    size_t n;
+} mb_work_t;
+
+static void *mb_worker(void *arg)
+{
+    mb_work_t *w = (mb_work_t *) arg;
+
+    sha3_mb_hash(w->p, w->jobs, w->n);
+
+    return NULL;
+}
+
+void sha3_mb_hash_mt(const sha3_mb_param_t *p, const sha3_job_t *jobs,
+    size_t n, int nthreads)
+{
+    pthread_t tid[MB_MAXTHREADS];
+    mb_work_t w[MB_MAXTHREADS];
+    int started[MB_MAXTHREADS];
+    size_t per, minjobs, i0;
+    int t;
+
+    if (n == 0)
+        return;
+    if (nthreads <= 0)
+        nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > MB_MAXTHREADS)
+        nthreads = MB_MAXTHREADS;
+    minjobs = MB_MINBYTES / (jobs[0].inlen + 1) + 1;
+    if ((size_t) nthreads > n / minjobs)
+        nthreads = (int) (n / minjobs);
+    if (nthreads < 1)
+        nthreads = 1;
+
+    per = (n + nthreads - 1) / nthreads;
+    for (t = 0; t < nthreads; t++) {
+        i0 = per * t;
+        w[t].p = p;
+        w[t].jobs = jobs + i0;
+        w[t].n = i0 < n ? (n - i0 < per ? n - i0 : per) : 0;
+        started[t] = t > 0 &&
+            pthread_create(&tid[t], NULL, mb_worker, &w[t]) == 0;
+    }
+
+    for (t = 0; t < nthreads; t++) {
+        if (!started[t])
+            mb_worker(&w[t]);
+    }
+    for (t = 1; t < nthreads; t++) {
+        if (started[t])
+            pthread_join(tid[t], NULL);
+    }
+}
+
+// SHA3 digests of n independent messages
+
+int sha3_batch(const sha3_job_t *jobs, size_t n, int mdlen)
+{
+    sha3_mb_param_t p;
+    size_t i;
+
+    p.rsiz = 200 - 2 * mdlen;
+    p.mdlen = mdlen;
+    p.nrounds = 24;
+    p.ds = 0x06;
+    p.iv = NULL;
+    p.pt = 0;
+
+    if (mdlen <= 0 || p.rsiz <= mdlen || (p.rsiz & 7) != 0) {
+        for (i = 0; i < n; i++)
+            sha3(jobs[i].in, jobs[i].inlen, jobs[i].md, mdlen);
+        return 1;
+    }
+    sha3_mb_hash(&p, jobs, n);
+
+    return 1;
+}
+
+// SHA3 digests of mid || jobs[i].in: the shared prefix in mid is absorbed
+// once, its state is the starting point of every lane
+
+int sha3_batch_suffix(const sha3_ctx_t *mid, const sha3_job_t *jobs,
+    size_t n)
+{
+    sha3_mb_param_t p;
+    sha3_ctx_t c;
+    uint64_t iv[25];
+    size_t i;
+
+    p.rsiz = mid->rsiz;
+    p.mdlen = mid->mdlen;
+    p.nrounds = 24;
+    p.ds = (uint8_t) mid->dsbyte;
+    p.iv = iv;
+    p.pt = mid->pt;
+
+    if (p.mdlen <= 0 || p.rsiz <= p.mdlen || (p.rsiz & 7) != 0) {
+        for (i = 0; i < n; i++) {
+            sha3_ctx_clone(&c, mid);
+            sha3_update(&c, jobs[i].in, jobs[i].inlen);
+            sha3_final(jobs[i].md, &c);
+        }
+        return 1;
+    }
+    for (i = 0; i < 25; i++)
+        iv[i] = SHA3_LE64(mid->st.q[i]);
+    sha3_mb_hash(&p, jobs, n);
+
+    return 1;
+}
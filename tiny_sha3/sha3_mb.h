@@ -0,0 +1,30 @@
+// sha3_mb.h
+// Internal: multi-buffer sponge engine behind sha3_batch() and the other
+// batched front ends.
+
+#ifndef SHA3_MB_H
+#define SHA3_MB_H
+
+#include "sha3.h"
+
+typedef struct {
+    int rsiz;                               // rate in bytes, multiple of 8
+    int mdlen;                              // output bytes, <= rsiz
+    int nrounds;                            // Keccak-p[1600, nrounds];
+                                            // 24 is Keccak-f
+    uint8_t ds;                             // first padding byte
+    const uint64_t *iv;                     // 25 native lanes or NULL
+    int pt;                                 // bytes of iv block in use
+} sha3_mb_param_t;
+
+// hash n independent messages; one output block each. every message
+// starts from iv (a midstate with pt < rsiz bytes of its block absorbed),
+// or from the zero state if iv is NULL.
+void sha3_mb_hash(const sha3_mb_param_t *p, const sha3_job_t *jobs, size_t n);
+
+// the same over up to nthreads threads (0: one per online CPU), each with
+// a contiguous range of jobs; small batches stay on fewer threads
+void sha3_mb_hash_mt(const sha3_mb_param_t *p, const sha3_job_t *jobs,
+    size_t n, int nthreads);
+
+#endif
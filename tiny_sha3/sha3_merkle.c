@@ -0,0 +1,267 @@
+// sha3_merkle.c
+// SHA3-256 Merkle tree over fixed-size chunks of a file, kept on disk
+// between runs. After an edit only the leaves the caller marks dirty and
+// the nodes above them are hashed again. A leaf is SHA3-256 of 0x00 and
+// its chunk, an internal node SHA3-256 of 0x01 and its two children, so
+// no leaf can pass for a node. Both start from a one-byte midstate in the
+// multi-buffer engine, leaves over threads; a run of dirty parents is one
+// batch since their children lie back to back. A lone last node moves up
+// unchanged. The cache is written to a temporary file, synced and renamed
+// over the old one, so a crash leaves either of them whole.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sha3_mb.h"
+
+#define MERKLE_RUN  64                      // parents per batch call
+
+static const char merkle_magic[8] = "SHA3MT02";
+
+// the tag byte absorbed: 0x00 for leaves, 0x01 for nodes (lane 0, byte 0)
+static const uint64_t merkle_iv[2][25] = { { 0 }, { 1 } };
+
+typedef struct {
+    char magic[8];
+    uint64_t size;                          // of the file
+    uint64_t chunk;
+} merkle_hdr_t;
+
+// level widths and offsets for the file size; all levels back to back
+
+static void merkle_shape(sha3_merkle_t *t)
+{
+    uint64_t w;
+
+    w = (t->size + t->chunk - 1) / t->chunk;
+    if (w == 0)
+        w = 1;                              // empty file: one empty leaf
+    t->nnodes = 0;
+    for (t->levels = 0; ; t->levels++) {
+        t->width[t->levels] = w;
+        t->off[t->levels] = t->nnodes;
+        t->nnodes += w;
+        if (w == 1)
+            break;
+        w = (w + 1) / 2;
+    }
+    t->levels++;
+}
+
+static int merkle_load(sha3_merkle_t *t)
+{
+    merkle_hdr_t h;
+    size_t len;
+    int fd, ok;
+
+    if ((fd = open(t->cache, O_RDONLY)) < 0)
+        return 0;
+    len = 32 * t->nnodes;
+    ok = read(fd, &h, sizeof(h)) == sizeof(h) &&
+        memcmp(h.magic, merkle_magic, 8) == 0 &&
+        h.size == t->size && h.chunk == t->chunk &&
+        pread(fd, t->node, len, sizeof(h)) == (ssize_t) len;
+    close(fd);
+
+    return ok;
+}
+
+// write a temporary next to the cache, sync it and rename it over
+
+static int merkle_save(sha3_merkle_t *t)
+{
+    merkle_hdr_t h;
+    char *tmp;
+    size_t len;
+    int fd, ok;
+
+    len = strlen(t->cache) + 8;
+    if ((tmp = (char *) malloc(len)) == NULL)
+        return 0;
+    snprintf(tmp, len, "%s.XXXXXX", t->cache);
+    if ((fd = mkstemp(tmp)) < 0) {
+        free(tmp);
+        return 0;
+    }
+    memcpy(h.magic, merkle_magic, 8);
+    h.size = t->size;
+    h.chunk = t->chunk;
+    len = 32 * t->nnodes;
+    ok = write(fd, &h, sizeof(h)) == sizeof(h) &&
+        write(fd, t->node, len) == (ssize_t) len &&
+        fchmod(fd, 0644) == 0 && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok && rename(tmp, t->cache) == 0;
+    if (!ok)
+        unlink(tmp);
+    free(tmp);
+
+    return ok;
+}
+
+// parents a .. b - 1 into hi from their children in lo
+
+static void merkle_parents(uint8_t *hi, const uint8_t *lo, uint64_t a,
+    uint64_t b)
+{
+    sha3_mb_param_t p = { 136, 32, 24, 0x06, merkle_iv[1], 1 };
+    sha3_job_t jobs[MERKLE_RUN];
+    size_t n;
+
+    while (a < b) {
+        for (n = 0; n < MERKLE_RUN && a < b; n++, a++) {
+            jobs[n].in = lo + 64 * a;
+            jobs[n].inlen = 64;
+            jobs[n].md = hi + 32 * a;
+        }
+        sha3_mb_hash(&p, jobs, n);
+    }
+}
+
+// map the file, load the node cache or mark every leaf dirty
+
+int sha3_merkle_open(sha3_merkle_t *t, const char *path, const char *cache,
+    size_t chunk, int nthreads)
+{
+    struct stat sb;
+
+    memset(t, 0, sizeof(*t));
+    t->map = MAP_FAILED;
+    t->fd = chunk > 0 ? open(path, O_RDONLY) : -1;
+    if (t->fd < 0)
+        return 0;
+    if (fstat(t->fd, &sb) != 0)
+        goto fail;
+    t->size = sb.st_size;
+    t->chunk = chunk;
+    t->nthreads = nthreads;
+    if (t->size > 0) {
+        t->map = (const uint8_t *) mmap(NULL, t->size, PROT_READ,
+            MAP_SHARED, t->fd, 0);
+        if (t->map == MAP_FAILED)
+            goto fail;
+    }
+
+    merkle_shape(t);
+    t->node = (uint8_t *) malloc(32 * t->nnodes);
+    t->dirty = (uint8_t *) malloc(t->width[0]);
+    if (cache != NULL)
+        t->cache = strdup(cache);
+    if (t->node == NULL || t->dirty == NULL ||
+        (cache != NULL && t->cache == NULL))
+        goto fail;
+
+    t->ndirty = cache != NULL && merkle_load(t) ? 0 : t->width[0];
+    memset(t->dirty, t->ndirty != 0, t->width[0]);
+
+    return 1;
+
+fail:
+    sha3_merkle_close(t);
+    return 0;
+}
+
+// the bytes off .. off + len - 1 have changed since the last root
+
+void sha3_merkle_dirty(sha3_merkle_t *t, uint64_t off, uint64_t len)
+{
+    uint64_t i, last;
+
+    if (len == 0 || off >= t->size)
+        return;
+    if (len > t->size - off)
+        len = t->size - off;
+    last = (off + len - 1) / t->chunk;
+    for (i = off / t->chunk; i <= last; i++) {
+        t->ndirty += !t->dirty[i];
+        t->dirty[i] = 1;
+    }
+}
+
+// rehash what is dirty, save the cache, and give the root: SHA3-256 of
+// the top node, the file size and the chunk size (64-bit little-endian)
+
+int sha3_merkle_root(sha3_merkle_t *t, void *md)
+{
+    sha3_mb_param_t p = { 136, 32, 24, 0x06, merkle_iv[0], 1 };
+    sha3_job_t *jobs;
+    sha3_ctx_t c;
+    uint8_t *lo, *hi, len[16];
+    uint64_t i, j, n, w;
+    int l, ok;
+
+    ok = 1;
+    if (t->ndirty > 0) {
+        jobs = (sha3_job_t *) malloc(t->ndirty * sizeof(sha3_job_t));
+        if (jobs == NULL)
+            return 0;
+        n = 0;
+        for (i = 0; i < t->width[0]; i++) {
+            if (!t->dirty[i])
+                continue;
+            jobs[n].in = t->size > 0 ? t->map + t->chunk * i : NULL;
+            jobs[n].inlen = t->chunk * (i + 1) <= t->size ? t->chunk :
+                t->size - t->chunk * i;
+            jobs[n].md = t->node + 32 * i;
+            n++;
+        }
+        sha3_mb_hash_mt(&p, jobs, n, t->nthreads);
+        free(jobs);
+
+        // parents of dirty nodes, a level at a time; dirty[] shrinks
+        // in place, parent j from children 2j and 2j + 1
+        for (l = 0; l + 1 < t->levels; l++) {
+            w = t->width[l];
+            lo = t->node + 32 * t->off[l];
+            hi = t->node + 32 * t->off[l + 1];
+            for (j = 0; j < t->width[l + 1]; j++)
+                t->dirty[j] = t->dirty[2 * j] |
+                    (2 * j + 1 < w ? t->dirty[2 * j + 1] : 0);
+            for (j = 0; j < t->width[l + 1]; j = i) {
+                if (!t->dirty[j]) {
+                    i = j + 1;
+                    continue;
+                }
+                for (i = j; i < t->width[l + 1] && t->dirty[i] &&
+                    2 * i + 1 < w; i++)
+                    ;
+                merkle_parents(hi, lo, j, i);
+                if (i == j) {                   // lone last node
+                    memcpy(hi + 32 * j, lo + 64 * j, 32);
+                    i++;
+                }
+            }
+        }
+        memset(t->dirty, 0, t->width[0]);
+        t->ndirty = 0;
+        if (t->cache != NULL)
+            ok = merkle_save(t);
+    }
+
+    for (i = 0; i < 8; i++) {
+        len[i] = (uint8_t) (t->size >> (8 * i));
+        len[i + 8] = (uint8_t) ((uint64_t) t->chunk >> (8 * i));
+    }
+    sha3_init(&c, 32);
+    sha3_update(&c, t->node + 32 * t->off[t->levels - 1], 32);
+    sha3_update(&c, len, sizeof(len));
+    sha3_final(md, &c);
+
+    return ok;
+}
+
+void sha3_merkle_close(sha3_merkle_t *t)
+{
+    if (t->map != MAP_FAILED && t->map != NULL)
+        munmap((void *) t->map, t->size);
+    if (t->fd >= 0)
+        close(t->fd);
+    free(t->node);
+    free(t->dirty);
+    free(t->cache);
+    memset(t, 0, sizeof(*t));
+    t->fd = -1;
+}
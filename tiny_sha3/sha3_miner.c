@@ -0,0 +1,510 @@
+// sha3_miner.c
+// Native nonce search with the semantics of hash_nonce() in sha3_hls.cpp:
+// the hash of a nonce is the low 32 bits of lane 0 after Keccak-f of the
+// padded one-lane block, i.e. the first four bytes of SHA3-256 of the
+// nonce in little-endian order, and a nonce wins when that is below the
+// target. sha3_mine_job() does the same for a nonce inside a header
+// template, from the midstate of the blocks before the last. Consecutive
+// nonces are hashed side by side, the block built in registers around a
+// vector of nonces, and compared against the target as a vector into a
+// bitmask of hits. Each thread owns a range of the nonce space and works
+// through it in chunks; a thread that runs dry steals the upper half of
+// the largest range left. The first hit raises a flag every thread polls
+// between small groups of nonces.
+
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+#define MINE_CHUNK      (1 << 14)           // nonces per take
+#define MINE_POLL       16                  // nonces between stop checks
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t lo, hi;                        // offsets from the start nonce
+} __attribute__((aligned(64))) mine_range_t;
+
+typedef struct {
+    const sha3_mine_job_t *job;
+    uint32_t start, target;
+    int nthreads;
+    mine_range_t range[SHA3_MINE_MAXTHREADS];
+    int stop;                               // set by the first hit
+    uint32_t nonce;
+    uint64_t steals;
+} mine_search_t;
+
+typedef struct {
+    mine_search_t *s;
+    int id;
+    uint64_t hashes;
+    double seconds;
+} mine_worker_t;
+
+static double mine_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1E-9 * ts.tv_nsec;
+}
+
+// hash_nonce(): nonce and the 0x06 pad in lane 0, the final bit at the top
+// of lane 16 (the last lane of the 136-byte rate)
+
+uint32_t sha3_mine_hash(uint32_t nonce)
+{
+    uint64_t st[25];
+
+    memset(st, 0, sizeof(st));
+    st[0] = SHA3_LE64((uint64_t) nonce | (uint64_t) 0x06 << 32);
+    st[16] = SHA3_LE64((uint64_t) 0x8000000000000000);
+    sha3_impl.keccakf(st);
+
+    return (uint32_t) SHA3_LE64(st[0]);
+}
+
+// round-1 midstate of a block st (native lanes, nonce bytes zero) with the
+// nonce at byte off of the rate
+
+void sha3_mine_r1_init(sha3_mine_r1_t *r1, const uint64_t st[25], int off)
+{
+    uint64_t c[5], d;
+    int i, x;
+
+    memcpy(r1->st, st, sizeof(r1->st));
+    for (x = 0; x < 5; x++)
+        c[x] = st[x] ^ st[x + 5] ^ st[x + 10] ^ st[x + 15] ^ st[x + 20];
+    for (i = 0; i < 25; i++) {
+        x = i % 5;
+        d = st[i] ^ c[(x + 4) % 5] ^ ROTL64(c[(x + 1) % 5], 1);
+        r1->b[keccakp_pi[i]] = keccakp_rho[i] == 0 ? d :
+            ROTL64(d, keccakp_rho[i]);
+    }
+
+    // the nonce lane(s), and the columns either side through D
+    r1->lane = off / 8;
+    r1->shift = 8 * (off % 8);
+    r1->aff = 0;
+    for (i = r1->lane; i <= r1->lane + (r1->shift > 32); i++) {
+        x = i % 5;
+        r1->aff |= (uint32_t) 1 << i;
+        r1->aff |= (uint32_t) 0x108421 << ((x + 1) % 5);
+        r1->aff |= (uint32_t) 0x108421 << ((x + 4) % 5);
+    }
+}
+
+// ways consecutive nonces from base: the nonce difference goes through
+// Theta into the affected lanes of the midstate, then Chi and Iota of
+// round 1 and the remaining rounds, the last one only as far as lane 0
+// needs. hashes to h (unless NULL), bit k of the result set when nonce
+// base + k is below target.
+
+#define MINE_LD(i)  c[i]
+
+#define MINE_BODY(T, W, r1, base, target, h) \
+    KECCAK_DECLARE_T(T, A); \
+    KECCAK_DECLARE_T(T, E); \
+    KECCAK_DECLARE_T(T, B); \
+    KECCAK_DECLARE_CD(T); \
+    T nv, z, d0, d1, t, dc[5], dd[5], b[25], c[25], hv, lt; \
+    uint32_t m; \
+    int i, k, x; \
+    for (k = 0; k < (W); k++) \
+        nv[k] = (uint32_t) ((base) + k); \
+    z = nv - nv; \
+    d0 = nv << (r1)->shift; \
+    d1 = (r1)->shift > 32 ? nv >> (64 - (r1)->shift) : z; \
+    for (x = 0; x < 5; x++) \
+        dc[x] = z; \
+    dc[(r1)->lane % 5] ^= d0; \
+    dc[((r1)->lane + 1) % 5] ^= d1; \
+    for (x = 0; x < 5; x++) \
+        dd[x] = dc[(x + 4) % 5] ^ ROTL64(dc[(x + 1) % 5], 1); \
+    _Pragma("GCC unroll 25") \
+    for (i = 0; i < 25; i++) \
+        b[i] = z + (r1)->b[i]; \
+    _Pragma("GCC unroll 25") \
+    for (i = 0; i < 25; i++) { \
+        if ((((r1)->aff >> i) & 1) == 0) \
+            continue; \
+        t = dd[i % 5]; \
+        if (i == (r1)->lane) \
+            t ^= d0; \
+        if (i == (r1)->lane + 1) \
+            t ^= d1; \
+        b[keccakp_pi[i]] ^= keccakp_rho[i] == 0 ? t : \
+            ROTL64(t, keccakp_rho[i]); \
+    } \
+    _Pragma("GCC unroll 5") \
+    for (i = 0; i < 25; i += 5) { \
+        _Pragma("GCC unroll 5") \
+        for (x = 0; x < 5; x++) \
+            c[i + x] = b[i + x] ^ (~b[i + (x + 1) % 5] & b[i + (x + 2) % 5]); \
+    } \
+    c[0] ^= keccakp_rndc[0]; \
+    KECCAK_LOAD_F(A, MINE_LD); \
+    KECCAK_ROUNDS_FROM_LAST(1, KECCAK_ROUND_ROW0); \
+    hv = Aba & 0xFFFFFFFF; \
+    lt = (T) (hv < (target)); \
+    m = 0; \
+    for (k = 0; k < (W); k++) { \
+        m |= (uint32_t) (lt[k] & 1) << k; \
+        if ((h) != NULL) \
+            (h)[k] = (uint32_t) hv[k]; \
+    } \
+    return m
+
+typedef uint64_t sha3_v4 __attribute__((vector_size(32)));
+typedef uint64_t sha3_v8 __attribute__((vector_size(64)));
+
+static inline __attribute__((always_inline))
+uint32_t mine_x4(const sha3_mine_r1_t *r1, uint32_t base, uint32_t target,
+    uint32_t *h)
+{
+    MINE_BODY(sha3_v4, 4, r1, base, target, h);
+}
+
+static inline __attribute__((always_inline))
+uint32_t mine_x8(const sha3_mine_r1_t *r1, uint32_t base, uint32_t target,
+    uint32_t *h)
+{
+    MINE_BODY(sha3_v8, 8, r1, base, target, h);
+}
+
+uint32_t sha3_mine_x4_generic(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    return mine_x4(r1, base, target, h);
+}
+
+uint32_t sha3_mine_x8_generic(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    return mine_x8(r1, base, target, h);
+}
+
+#ifdef SHA3_X86
+__attribute__((target("avx2")))
+uint32_t sha3_mine_x4_avx2(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    return mine_x4(r1, base, target, h);
+}
+
+__attribute__((target("avx2")))
+uint32_t sha3_mine_x8_avx2(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    return mine_x8(r1, base, target, h);
+}
+
+__attribute__((target("avx512f")))
+uint32_t sha3_mine_x8_avx512(const sha3_mine_r1_t *r1, uint32_t base,
+    uint32_t target, uint32_t *h)
+{
+    return mine_x8(r1, base, target, h);
+}
+#endif
+
+// header template: absorb the blocks before the last one, then XOR in the
+// last block with the nonce bytes left out and the padding
+
+int sha3_mine_job_init(sha3_mine_job_t *job, const void *hdr, size_t len,
+    size_t nonce_off)
+{
+    const uint8_t *p = (const uint8_t *) hdr;
+    sha3_ctx_t c;
+    uint64_t st[25];
+    size_t last;
+    int i;
+
+    sha3_init(&c, 32);
+    last = len - len % c.rsiz;              // a full last block means the
+    if (len < 4 || nonce_off < last || nonce_off > len - 4)
+        return 0;                           // padding is a block of its own
+
+    sha3_update(&c, p, len);
+    for (i = 0; i < 4; i++)
+        c.st.b[nonce_off - last + i] ^= p[nonce_off + i];
+    c.st.b[c.pt] ^= 0x06;
+    c.st.b[c.rsiz - 1] ^= 0x80;
+
+    for (i = 0; i < 25; i++)
+        st[i] = SHA3_LE64(c.st.q[i]);
+    job->off = (int) (nonce_off - last);
+    sha3_mine_r1_init(&job->r1, st, job->off);
+
+    return 1;
+}
+
+uint32_t sha3_mine_job_hash(const sha3_mine_job_t *job, uint32_t nonce)
+{
+    uint64_t st[25];
+    int i;
+
+    memcpy(st, job->r1.st, sizeof(st));
+    st[job->r1.lane] ^= (uint64_t) nonce << job->r1.shift;
+    if (job->r1.shift > 32)
+        st[job->r1.lane + 1] ^= (uint64_t) nonce >> (64 - job->r1.shift);
+    for (i = 0; i < 25; i++)
+        st[i] = SHA3_LE64(st[i]);
+    sha3_impl.keccakf(st);
+
+    return (uint32_t) SHA3_LE64(st[0]);
+}
+
+// the hash_nonce() job: a header that is just the nonce. built once,
+// whichever thread gets here first
+
+static sha3_mine_job_t mine_default;
+static pthread_once_t mine_default_once = PTHREAD_ONCE_INIT;
+
+static void mine_job_default_init(void)
+{
+    static const uint8_t hdr[4];
+
+    sha3_mine_job_init(&mine_default, hdr, sizeof(hdr), 0);
+}
+
+static const sha3_mine_job_t *mine_job_default(void)
+{
+    pthread_once(&mine_default_once, mine_job_default_init);
+
+    return &mine_default;
+}
+
+void sha3_mine_hash_x4(uint32_t base, uint32_t target, uint32_t *mask,
+    uint32_t hash[4])
+{
+    *mask = sha3_impl.mine4(&mine_job_default()->r1, base, target, hash);
+}
+
+void sha3_mine_hash_x8(uint32_t base, uint32_t target, uint32_t *mask,
+    uint32_t hash[8])
+{
+    *mask = sha3_impl.mine8(&mine_job_default()->r1, base, target, hash);
+}
+
+// 64 nonces on the bitsliced kernel. only lane 0 differs between them, the
+// others are set to their constant. the compare runs on the bit planes of
+// the hash, from the top bit down: still-equal instances become "below"
+// where the target has a 1 and the hash a 0.
+
+void sha3_mine_hash_x64(uint32_t base, uint32_t target, uint64_t *mask,
+    uint32_t hash[64])
+{
+    uint64_t bs[25 * 64], v[64], lt, eq, tz;
+    int i, z;
+
+    for (i = 0; i < 64; i++)
+        v[i] = (uint32_t) (base + i) | (uint64_t) 0x06 << 32;
+    sha3_bs64_lane_in(bs, v);
+    for (i = 1; i < 25; i++)
+        sha3_bs64_lane_set(&bs[64 * i], i == 16 ? 0x8000000000000000 : 0);
+    sha3_impl.bs64(bs, 0);
+
+    lt = 0;
+    eq = ~(uint64_t) 0;
+    for (z = 31; z >= 0; z--) {
+        tz = 0 - (uint64_t) ((target >> z) & 1);
+        lt |= eq & tz & ~bs[z];
+        eq &= ~(bs[z] ^ tz);
+    }
+    *mask = lt;
+
+    if (hash != NULL) {
+        sha3_bs64_lane_out(v, bs);
+        for (i = 0; i < 64; i++)
+            hash[i] = (uint32_t) v[i];
+    }
+}
+
+// next chunk [*a, *b) for worker id: its own range first, then half of the
+// fullest other one. 0 when the space is exhausted.
+
+static int mine_take(mine_search_t *s, int id, uint64_t *a, uint64_t *b)
+{
+    mine_range_t *own = &s->range[id], *v;
+    uint64_t left, most, mid;
+    int i, best;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->lo < own->hi) {
+        *a = own->lo;
+        *b = own->hi - own->lo > MINE_CHUNK ? own->lo + MINE_CHUNK : own->hi;
+        own->lo = *b;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (;;) {
+        // unlocked scan for a victim; rechecked under its lock
+        best = -1;
+        most = 0;
+        for (i = 0; i < s->nthreads; i++) {
+            v = &s->range[i];
+            left = __atomic_load_n(&v->hi, __ATOMIC_RELAXED) -
+                __atomic_load_n(&v->lo, __ATOMIC_RELAXED);
+            if (i != id && (int64_t) left > (int64_t) most) {
+                best = i;
+                most = left;
+            }
+        }
+        if (best < 0)
+            return 0;
+
+        v = &s->range[best];
+        pthread_mutex_lock(&v->lock);
+        if (v->lo >= v->hi) {
+            pthread_mutex_unlock(&v->lock);
+            continue;                       // emptied meanwhile
+        }
+        left = v->hi - v->lo;
+        mid = left > MINE_CHUNK ? v->lo + left / 2 : v->lo;
+        *a = mid;
+        *b = v->hi;
+        v->hi = mid;
+        pthread_mutex_unlock(&v->lock);
+        __atomic_fetch_add(&s->steals, 1, __ATOMIC_RELAXED);
+
+        // keep the rest stealable from here
+        if (*b - *a > MINE_CHUNK) {
+            pthread_mutex_lock(&own->lock);
+            own->lo = *a + MINE_CHUNK;
+            own->hi = *b;
+            pthread_mutex_unlock(&own->lock);
+            *b = *a + MINE_CHUNK;
+        }
+        return 1;
+    }
+}
+
+static void *mine_worker(void *arg)
+{
+    mine_worker_t *w = (mine_worker_t *) arg;
+    mine_search_t *s = w->s;
+    uint64_t a, b, i, n;
+    const sha3_mine_r1_t *r1;
+    sha3_mine_fn kernel;
+    uint32_t x, m;
+    double t;
+    int ways;
+
+    ways = sha3_backend_ways();
+    kernel = ways == 8 ? sha3_impl.mine8 : sha3_impl.mine4;
+    r1 = &s->job->r1;
+
+    t = mine_now();
+    while (!__atomic_load_n(&s->stop, __ATOMIC_RELAXED) &&
+        mine_take(s, w->id, &a, &b)) {
+        for (; a < b; a += n) {
+            if (__atomic_load_n(&s->stop, __ATOMIC_RELAXED))
+                break;
+            n = b - a < MINE_POLL ? b - a : MINE_POLL;
+            for (i = 0; i < n; i += ways) {
+                x = s->start + (uint32_t) (a + i);
+                m = kernel(r1, x, s->target, NULL);
+                if (n - i < (uint64_t) ways)    // past the end of the chunk
+                    m &= (1u << (n - i)) - 1;
+
+                // candidates again through the full permutation
+                for (; m != 0; m &= m - 1) {
+                    if (sha3_mine_job_hash(s->job, x + __builtin_ctz(m)) <
+                        s->target)
+                        break;
+                }
+                if (m != 0 &&
+                    !__atomic_exchange_n(&s->stop, 1, __ATOMIC_ACQ_REL))
+                    s->nonce = x + __builtin_ctz(m);
+                if (m != 0)
+                    break;
+            }
+            w->hashes += n;
+        }
+    }
+    w->seconds = mine_now() - t;
+
+    return NULL;
+}
+
+// search count nonces of job from start (wrapping at 2^32) over nthreads
+// threads
+
+int sha3_mine_job(const sha3_mine_job_t *job, uint32_t start, uint64_t count,
+    uint32_t target, int nthreads, uint32_t *nonce, sha3_mine_stats_t *st)
+{
+    mine_search_t s;
+    pthread_t tid[SHA3_MINE_MAXTHREADS];
+    mine_worker_t w[SHA3_MINE_MAXTHREADS];
+    int started[SHA3_MINE_MAXTHREADS];
+    double t0;
+    int t, found;
+
+    if (count > (uint64_t) 1 << 32)
+        count = (uint64_t) 1 << 32;
+    if (nthreads <= 0)
+        nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > SHA3_MINE_MAXTHREADS)
+        nthreads = SHA3_MINE_MAXTHREADS;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    s.job = job;
+    s.start = start;
+    s.target = target;
+    s.nthreads = nthreads;
+    s.stop = 0;
+    s.nonce = 0;
+    s.steals = 0;
+    for (t = 0; t < nthreads; t++) {
+        pthread_mutex_init(&s.range[t].lock, NULL);
+        s.range[t].lo = count * t / nthreads;
+        s.range[t].hi = count * (t + 1) / nthreads;
+        w[t].s = &s;
+        w[t].id = t;
+        w[t].hashes = 0;
+        w[t].seconds = 0;
+    }
+
+    t0 = mine_now();
+    for (t = 1; t < nthreads; t++)
+        started[t] = pthread_create(&tid[t], NULL, mine_worker, &w[t]) == 0;
+    mine_worker(&w[0]);
+    for (t = 1; t < nthreads; t++) {
+        if (started[t])
+            pthread_join(tid[t], NULL);
+        else
+            mine_worker(&w[t]);             // its range, or what is left
+    }
+
+    found = s.stop;
+    if (found && nonce != NULL)
+        *nonce = s.nonce;
+    if (st != NULL) {
+        memset(st, 0, sizeof(*st));
+        st->seconds = mine_now() - t0;
+        st->nthreads = nthreads;
+        st->steals = s.steals;
+        for (t = 0; t < nthreads; t++) {
+            st->hashes += w[t].hashes;
+            st->thread_hashes[t] = w[t].hashes;
+            st->thread_seconds[t] = w[t].seconds;
+        }
+    }
+    for (t = 0; t < nthreads; t++)
+        pthread_mutex_destroy(&s.range[t].lock);
+
+    return found;
+}
+
+int sha3_mine(uint32_t start, uint64_t count, uint32_t target, int nthreads,
+    uint32_t *nonce, sha3_mine_stats_t *st)
+{
+    return sha3_mine_job(mine_job_default(), start, count, target, nthreads,
+        nonce, st);
+}
@@ -0,0 +1,75 @@
+// sha3_multi.c
+// Moving independent states in and out of the interleaved layout used by
+// the multi-state permutation kernels.
+
+#include "sha3_unrolled.h"
+
+// lane i of state k goes to st[i * n + k], in native byte order
+
+static void interleave(uint64_t *st, uint64_t *const q[], int n)
+{
+    int i, k;
+
+    for (i = 0; i < 25; i++) {
+        for (k = 0; k < n; k++)
+            st[i * n + k] = SHA3_LE64(q[k][i]);
+    }
+}
+
+static void deinterleave(uint64_t *const q[], const uint64_t *st, int n)
+{
+    int i, k;
+
+    for (i = 0; i < 25; i++) {
+        for (k = 0; k < n; k++)
+            q[k][i] = SHA3_LE64(st[i * n + k]);
+    }
+}
+
+void sha3_interleave(uint64_t *st, sha3_ctx_t *const c[], int n)
+{
+    uint64_t *q[SHA3_MAX_WAYS];
+    int k;
+
+    for (k = 0; k < n; k++)
+        q[k] = c[k]->st.q;
+    interleave(st, q, n);
+}
+
+void sha3_deinterleave(sha3_ctx_t *const c[], const uint64_t *st, int n)
+{
+    uint64_t *q[SHA3_MAX_WAYS];
+    int k;
+
+    for (k = 0; k < n; k++)
+        q[k] = c[k]->st.q;
+    deinterleave(q, st, n);
+}
+
+// permute n independent states, grouped onto the multi-state kernels
+
+void sha3_keccakf_batch(uint64_t (*st)[25], size_t n)
+{
+    uint64_t v[SHA3_MAX_WAYS * 25] __attribute__((aligned(64)));
+    uint64_t *q[SHA3_MAX_WAYS];
+    void (*keccakf)(uint64_t *st);
+    int k, ways;
+
+    ways = sha3_backend_ways();
+    keccakf = ways == 8 ? sha3_keccakf_x8 : sha3_keccakf_x4;
+
+    while (n >= (size_t) ways) {
+        for (k = 0; k < ways; k++)
+            q[k] = st[k];
+        interleave(v, q, ways);
+        keccakf(v);
+        deinterleave(q, v, ways);
+        st += ways;
+        n -= ways;
+    }
+
+    while (n > 0) {
+        sha3_keccakf(*st++);
+        n--;
+    }
+}
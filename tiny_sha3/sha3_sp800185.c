@@ -0,0 +1,200 @@
+// sha3_sp800185.c
+// NIST SP 800-185: cSHAKE, KMAC, TupleHash and ParallelHash. The encoded
+// strings and key are absorbed piece by piece straight from the caller's
+// buffers; bytepad() zero fill costs nothing since XOR with zero is a
+// no-op, it only closes the block. ParallelHash blocks are multi-buffer
+// jobs, over threads and the multi-state kernels.
+
+#include <stdlib.h>
+#include <string.h>
+#include "sha3_mb.h"
+
+#define SP_ENCMAX   (sizeof(uint64_t) + 1)
+
+// left_encode(x) and right_encode(x): big-endian bytes of x, at least one,
+// with their count in front or behind
+
+static size_t sp_bytes(uint8_t *buf, uint64_t x)
+{
+    size_t i, n;
+
+    for (n = 1; n < sizeof(uint64_t) && (x >> (8 * n)) != 0; n++)
+        ;
+    for (i = 0; i < n; i++)
+        buf[i] = (uint8_t) (x >> (8 * (n - 1 - i)));
+
+    return n;
+}
+
+static void sp_left(sha3_ctx_t *c, uint64_t x)
+{
+    uint8_t buf[SP_ENCMAX];
+    size_t n;
+
+    n = sp_bytes(buf + 1, x);
+    buf[0] = (uint8_t) n;
+    sha3_update(c, buf, n + 1);
+}
+
+static void sp_right(sha3_ctx_t *c, uint64_t x)
+{
+    uint8_t buf[SP_ENCMAX];
+    size_t n;
+
+    n = sp_bytes(buf, x);
+    buf[n] = (uint8_t) n;
+    sha3_update(c, buf, n + 1);
+}
+
+// encode_string(s)
+
+static void sp_string(sha3_ctx_t *c, const void *s, size_t len)
+{
+    sp_left(c, (uint64_t) len << 3);
+    sha3_update(c, s, len);
+}
+
+// end of bytepad(): the rest of the block is zero
+
+static void sp_pad(sha3_ctx_t *c)
+{
+    if (c->pt != 0) {
+        sha3_keccakf(c->st.q);
+        c->pt = 0;
+    }
+}
+
+static int sp_init(sha3_ctx_t *c, int bits)
+{
+    if (bits != 128 && bits != 256)
+        return 0;
+    shake_init(c, bits / 8);
+
+    return 1;
+}
+
+// cSHAKE
+
+int cshake_init(sha3_ctx_t *c, int bits, const void *n, size_t nlen,
+    const void *s, size_t slen)
+{
+    if (!sp_init(c, bits))
+        return 0;
+    if (nlen == 0 && slen == 0)             // plain SHAKE
+        return 1;
+    c->dsbyte = 0x04;
+
+    sp_left(c, c->rsiz);
+    sp_string(c, n, nlen);
+    sp_string(c, s, slen);
+    sp_pad(c);
+
+    return 1;
+}
+
+void cshake_xof(sha3_ctx_t *c)
+{
+    shake_xof(c);
+}
+
+// KMAC
+
+int kmac_init(sha3_ctx_t *c, int bits, const void *key, size_t klen,
+    const void *s, size_t slen)
+{
+    if (!cshake_init(c, bits, "KMAC", 4, s, slen))
+        return 0;
+    sp_left(c, c->rsiz);
+    sp_string(c, key, klen);
+    sp_pad(c);
+
+    return 1;
+}
+
+void kmac_final(sha3_ctx_t *c, void *mac, size_t len)
+{
+    sp_right(c, (uint64_t) len << 3);
+    cshake_xof(c);
+    shake_out(c, mac, len);
+}
+
+void kmac_xof(sha3_ctx_t *c)
+{
+    sp_right(c, 0);
+    cshake_xof(c);
+}
+
+// TupleHash
+
+int tuplehash_init(sha3_ctx_t *c, int bits, const void *s, size_t slen)
+{
+    return cshake_init(c, bits, "TupleHash", 9, s, slen);
+}
+
+void tuplehash_add(sha3_ctx_t *c, const void *x, size_t len)
+{
+    sp_string(c, x, len);
+}
+
+void tuplehash_final(sha3_ctx_t *c, void *out, size_t len)
+{
+    kmac_final(c, out, len);                // same suffix and padding
+}
+
+void tuplehash_xof(sha3_ctx_t *c)
+{
+    kmac_xof(c);
+}
+
+// ParallelHash: SHAKE of each b-byte block as a batch, then cSHAKE over
+// left_encode(b) || the block digests || right_encode(n) || right_encode(L)
+
+int parallelhash(int bits, const void *in, size_t inlen, size_t b,
+    const void *s, size_t slen, void *out, size_t outlen, int xof,
+    int nthreads)
+{
+    const uint8_t *m = (const uint8_t *) in;
+    sha3_mb_param_t p;
+    sha3_job_t *jobs;
+    sha3_ctx_t c;
+    uint8_t *cv;
+    size_t i, n;
+
+    if ((bits != 128 && bits != 256) || b == 0)
+        return 0;
+
+    n = (inlen + b - 1) / b;
+    p.rsiz = 200 - bits / 4;
+    p.mdlen = bits / 4;
+    p.nrounds = 24;
+    p.ds = 0x1F;
+    p.iv = NULL;
+    p.pt = 0;
+
+    jobs = (sha3_job_t *) malloc((n + 1) * sizeof(sha3_job_t));
+    cv = (uint8_t *) malloc((n + 1) * p.mdlen);
+    if (jobs == NULL || cv == NULL) {
+        free(jobs);
+        free(cv);
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        jobs[i].in = m + b * i;
+        jobs[i].inlen = i + 1 < n ? b : inlen - b * i;
+        jobs[i].md = cv + p.mdlen * i;
+    }
+    sha3_mb_hash_mt(&p, jobs, n, nthreads);
+
+    cshake_init(&c, bits, "ParallelHash", 12, s, slen);
+    sp_left(&c, b);
+    sha3_update(&c, cv, n * p.mdlen);
+    sp_right(&c, n);
+    sp_right(&c, xof ? 0 : (uint64_t) outlen << 3);
+    cshake_xof(&c);
+    shake_out(&c, out, outlen);
+
+    free(jobs);
+    free(cv);
+
+    return 1;
+}
@@ -0,0 +1,197 @@
+// sha3_stream.c
+// Overlapped read and hash of one large file or stream. A reader thread
+// fills a ring of aligned buffers while the calling thread absorbs the
+// filled ones, so the disk and the permutation work at the same time and
+// the pipeline runs at the speed of the slower stage.
+
+#define _GNU_SOURCE                         // O_DIRECT
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha3.h"
+
+#define STREAM_NBUF     4
+#define STREAM_BUFSIZE  (1 << 20)
+#define STREAM_ALIGN    4096                // O_DIRECT wants block alignment
+
+typedef struct {
+    int fd;
+    uint8_t *buf[STREAM_NBUF];
+    size_t len[STREAM_NBUF];                // bytes in a filled buffer
+    int filled[STREAM_NBUF];
+    int eof, err;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    sha3_stream_stats_t st;
+} stream_ring_t;
+
+static double stream_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1E-9 * ts.tv_nsec;
+}
+
+// fill one buffer completely unless the input ends. a file system that
+// takes O_DIRECT at open but not for this read (or a short read that left
+// the offset unaligned) gets EINVAL: drop to buffered reads and go on.
+
+static ssize_t stream_fill(int fd, uint8_t *buf)
+{
+    ssize_t n, r;
+    int err, fl;
+
+    for (n = 0; n < STREAM_BUFSIZE; n += r) {
+        r = read(fd, buf + n, STREAM_BUFSIZE - n);
+        if (r == 0)
+            break;
+        if (r < 0) {
+            err = errno;
+            if (err == EINTR) {
+                r = 0;
+                continue;
+            }
+#ifdef O_DIRECT
+            if (err == EINVAL && (fl = fcntl(fd, F_GETFL)) >= 0 &&
+                (fl & O_DIRECT) && fcntl(fd, F_SETFL, fl & ~O_DIRECT) == 0) {
+                r = 0;
+                continue;
+            }
+#endif
+            errno = err;
+            return -1;
+        }
+    }
+
+    return n;
+}
+
+static void *stream_reader(void *arg)
+{
+    stream_ring_t *q = (stream_ring_t *) arg;
+    double t;
+    ssize_t n;
+    int i;
+
+    for (i = 0; ; i = (i + 1) % STREAM_NBUF) {
+        pthread_mutex_lock(&q->lock);
+        if (q->filled[i]) {
+            q->st.read_stalls++;
+            t = stream_now();
+            while (q->filled[i])
+                pthread_cond_wait(&q->cond, &q->lock);
+            q->st.read_stall_s += stream_now() - t;
+        }
+        pthread_mutex_unlock(&q->lock);
+
+        n = stream_fill(q->fd, q->buf[i]);
+
+        pthread_mutex_lock(&q->lock);
+        if (n < 0)
+            q->err = errno;
+        q->len[i] = n > 0 ? n : 0;
+        q->filled[i] = n > 0;
+        q->eof = n < STREAM_BUFSIZE;
+        pthread_cond_broadcast(&q->cond);
+        pthread_mutex_unlock(&q->lock);
+        if (n < STREAM_BUFSIZE)
+            break;
+    }
+
+    return NULL;
+}
+
+// absorb everything from fd into c; errno tells a failed read
+
+int sha3_stream_update(sha3_ctx_t *c, int fd, sha3_stream_stats_t *stats)
+{
+    stream_ring_t q;
+    pthread_t tid;
+    double t, t0;
+    int i, done;
+
+    memset(&q, 0, sizeof(q));
+    q.fd = fd;
+    for (i = 0; i < STREAM_NBUF; i++) {
+        if (posix_memalign((void **) &q.buf[i], STREAM_ALIGN,
+            STREAM_BUFSIZE) != 0) {
+            q.buf[i] = NULL;
+            q.err = ENOMEM;
+        }
+    }
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_cond_init(&q.cond, NULL);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    t0 = stream_now();
+    if (q.err == 0 &&
+        (q.err = pthread_create(&tid, NULL, stream_reader, &q)) == 0) {
+        for (i = 0; ; i = (i + 1) % STREAM_NBUF) {
+            pthread_mutex_lock(&q.lock);
+            if (!q.filled[i] && !q.eof) {
+                q.st.hash_stalls++;
+                t = stream_now();
+                while (!q.filled[i] && !q.eof)
+                    pthread_cond_wait(&q.cond, &q.lock);
+                q.st.hash_stall_s += stream_now() - t;
+            }
+            done = !q.filled[i];
+            pthread_mutex_unlock(&q.lock);
+            if (done)
+                break;
+
+            sha3_update(c, q.buf[i], q.len[i]);
+            q.st.bytes += q.len[i];
+
+            pthread_mutex_lock(&q.lock);
+            q.filled[i] = 0;
+            pthread_cond_broadcast(&q.cond);
+            pthread_mutex_unlock(&q.lock);
+        }
+        pthread_join(tid, NULL);
+    }
+    q.st.total_s = stream_now() - t0;
+
+    pthread_cond_destroy(&q.cond);
+    pthread_mutex_destroy(&q.lock);
+    for (i = 0; i < STREAM_NBUF; i++)
+        free(q.buf[i]);
+    if (stats != NULL)
+        *stats = q.st;
+    if (q.err != 0)
+        errno = q.err;
+
+    return q.err == 0;
+}
+
+// SHA3 digest of a file through the pipeline
+
+int sha3_stream_file(const char *path, void *md, int mdlen, int flags,
+    sha3_stream_stats_t *stats)
+{
+    sha3_ctx_t c;
+    int fd, ok;
+
+    fd = -1;
+#ifdef O_DIRECT
+    if (flags & SHA3_STREAM_DIRECT)
+        fd = open(path, O_RDONLY | O_DIRECT);
+#endif
+    if (fd < 0)
+        fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    sha3_init(&c, mdlen);
+    ok = sha3_stream_update(&c, fd, stats);
+    if (ok)
+        sha3_final(md, &c);
+    close(fd);
+
+    return ok;
+}
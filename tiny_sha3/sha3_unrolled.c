@@ -0,0 +1,23 @@
+// sha3_unrolled.c
+// Unrolled, lane-complemented scalar Keccak-f[1600] backend.
+
+#include "sha3_unrolled.h"
+
+void sha3_keccakf_unrolled(uint64_t st[25])
+{
+    keccakp_unrolled(st, 0);
+}
+
+// Keccak-p[1600, 24 - r0]; one jump into the unrolled sequence
+
+void sha3_keccakp_unrolled(uint64_t st[25], int r0)
+{
+    keccakp_unrolled(st, r0);
+}
+
+// 12 rounds, as used by KangarooTwelve and TurboSHAKE
+
+void sha3_keccakp12_unrolled(uint64_t st[25])
+{
+    keccakp_unrolled(st, 12);
+}
@@ -0,0 +1,232 @@
+// sha3_unrolled.h
+// Fully unrolled Keccak-p[1600] rounds with all 25 lanes in local variables
+// and constant rotation amounts. Uses the lane-complementing transform: lanes
+// be, bi, go, ki, mi, sa are kept inverted, which turns most of the NOTs in
+// Chi into ORs. Internal header; everything here is static inline so that
+// specialized kernels can embed the rounds directly.
+
+#ifndef SHA3_UNROLLED_H
+#define SHA3_UNROLLED_H
+
+#include "sha3.h"
+
+// lanes are little-endian in memory
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#define SHA3_LE64(x) __builtin_bswap64(x)
+#else
+#define SHA3_LE64(x) (x)
+#endif
+
+static const uint64_t keccakp_rndc[24] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808a,
+    0x8000000080008000, 0x000000000000808b, 0x0000000080000001,
+    0x8000000080008081, 0x8000000000008009, 0x000000000000008a,
+    0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
+    0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+    0x000000000000800a, 0x800000008000000a, 0x8000000080008081,
+    0x8000000000008080, 0x0000000080000001, 0x8000000080008008
+};
+
+// Rho rotation of lane i, and the destination of lane i under Pi
+
+static const int keccakp_rho[25] = {
+     0,  1, 62, 28, 27, 36, 44,  6, 55, 20,  3, 10, 43,
+    25, 39, 41, 45, 15, 21,  8, 18,  2, 61, 56, 14
+};
+
+static const int keccakp_pi[25] = {
+     0, 10, 20,  5, 15, 16,  1, 11, 21,  6,  7, 17,  2,
+    12, 22, 23,  8, 18,  3, 13, 14, 24,  9, 19,  4
+};
+
+// lane names: row b, g, k, m, s (y = 0..4), column a, e, i, o, u (x = 0..4).
+// the round macros only use C operators on the lanes, so T may also be a
+// GCC vector type holding the same lane of several states.
+
+#define KECCAK_DECLARE_T(T, X) \
+    T X##ba, X##be, X##bi, X##bo, X##bu, \
+      X##ga, X##ge, X##gi, X##go, X##gu, \
+      X##ka, X##ke, X##ki, X##ko, X##ku, \
+      X##ma, X##me, X##mi, X##mo, X##mu, \
+      X##sa, X##se, X##si, X##so, X##su
+
+#define KECCAK_DECLARE(X) KECCAK_DECLARE_T(uint64_t, X)
+
+#define KECCAK_DECLARE_CD(T) \
+    T Ca, Ce, Ci, Co, Cu, Da, De, Di, Do, Du
+
+// load and store apply the lane complement mask. LD(i) reads lane i,
+// ST(i, v) writes it.
+
+#define KECCAK_LOAD_F(X, LD) \
+    X##ba =  LD( 0); X##be = ~LD( 1); X##bi = ~LD( 2); X##bo =  LD( 3); \
+    X##bu =  LD( 4); X##ga =  LD( 5); X##ge =  LD( 6); X##gi =  LD( 7); \
+    X##go = ~LD( 8); X##gu =  LD( 9); X##ka =  LD(10); X##ke =  LD(11); \
+    X##ki = ~LD(12); X##ko =  LD(13); X##ku =  LD(14); X##ma =  LD(15); \
+    X##me =  LD(16); X##mi = ~LD(17); X##mo =  LD(18); X##mu =  LD(19); \
+    X##sa = ~LD(20); X##se =  LD(21); X##si =  LD(22); X##so =  LD(23); \
+    X##su =  LD(24)
+
+#define KECCAK_STORE_F(ST, X) \
+    ST( 0,  X##ba); ST( 1, ~X##be); ST( 2, ~X##bi); ST( 3,  X##bo); \
+    ST( 4,  X##bu); ST( 5,  X##ga); ST( 6,  X##ge); ST( 7,  X##gi); \
+    ST( 8, ~X##go); ST( 9,  X##gu); ST(10,  X##ka); ST(11,  X##ke); \
+    ST(12, ~X##ki); ST(13,  X##ko); ST(14,  X##ku); ST(15,  X##ma); \
+    ST(16,  X##me); ST(17, ~X##mi); ST(18,  X##mo); ST(19,  X##mu); \
+    ST(20, ~X##sa); ST(21,  X##se); ST(22,  X##si); ST(23,  X##so); \
+    ST(24,  X##su)
+
+#define KECCAK_COPY(X, Y) \
+    X##ba = Y##ba; X##be = Y##be; X##bi = Y##bi; X##bo = Y##bo; X##bu = Y##bu; \
+    X##ga = Y##ga; X##ge = Y##ge; X##gi = Y##gi; X##go = Y##go; X##gu = Y##gu; \
+    X##ka = Y##ka; X##ke = Y##ke; X##ki = Y##ki; X##ko = Y##ko; X##ku = Y##ku; \
+    X##ma = Y##ma; X##me = Y##me; X##mi = Y##mi; X##mo = Y##mo; X##mu = Y##mu; \
+    X##sa = Y##sa; X##se = Y##se; X##si = Y##si; X##so = Y##so; X##su = Y##su
+
+// column parities of X into Ca..Cu; rounds keep these up to date themselves
+
+#define KECCAK_PARITY(X) \
+    Ca = X##ba ^ X##ga ^ X##ka ^ X##ma ^ X##sa; \
+    Ce = X##be ^ X##ge ^ X##ke ^ X##me ^ X##se; \
+    Ci = X##bi ^ X##gi ^ X##ki ^ X##mi ^ X##si; \
+    Co = X##bo ^ X##go ^ X##ko ^ X##mo ^ X##so; \
+    Cu = X##bu ^ X##gu ^ X##ku ^ X##mu ^ X##su
+
+// one round from state A to state E, using round constant i.
+// needs locals Ca..Cu, Da..Du and B##ba..B##su declared by the caller.
+
+#define KECCAK_ROUND(A, E, i) \
+    Da = Cu ^ ROTL64(Ce, 1); \
+    De = Ca ^ ROTL64(Ci, 1); \
+    Di = Ce ^ ROTL64(Co, 1); \
+    Do = Ci ^ ROTL64(Cu, 1); \
+    Du = Co ^ ROTL64(Ca, 1); \
+    \
+    Bba = A##ba ^ Da; \
+    Bbe = ROTL64(A##ge ^ De, 44); \
+    Bbi = ROTL64(A##ki ^ Di, 43); \
+    Bbo = ROTL64(A##mo ^ Do, 21); \
+    Bbu = ROTL64(A##su ^ Du, 14); \
+    E##ba = Bba ^ (Bbe | Bbi) ^ keccakp_rndc[i]; \
+    E##be = Bbe ^ (~Bbi | Bbo); \
+    E##bi = Bbi ^ (Bbo & Bbu); \
+    E##bo = Bbo ^ (Bbu | Bba); \
+    E##bu = Bbu ^ (Bba & Bbe); \
+    Ca = E##ba; Ce = E##be; Ci = E##bi; Co = E##bo; Cu = E##bu; \
+    \
+    Bga = ROTL64(A##bo ^ Do, 28); \
+    Bge = ROTL64(A##gu ^ Du, 20); \
+    Bgi = ROTL64(A##ka ^ Da,  3); \
+    Bgo = ROTL64(A##me ^ De, 45); \
+    Bgu = ROTL64(A##si ^ Di, 61); \
+    E##ga = Bga ^ (Bge | Bgi); \
+    E##ge = Bge ^ (Bgi & Bgo); \
+    E##gi = Bgi ^ (Bgo | ~Bgu); \
+    E##go = Bgo ^ (Bgu | Bga); \
+    E##gu = Bgu ^ (Bga & Bge); \
+    Ca ^= E##ga; Ce ^= E##ge; Ci ^= E##gi; Co ^= E##go; Cu ^= E##gu; \
+    \
+    Bka = ROTL64(A##be ^ De,  1); \
+    Bke = ROTL64(A##gi ^ Di,  6); \
+    Bki = ROTL64(A##ko ^ Do, 25); \
+    Bko = ROTL64(A##mu ^ Du,  8); \
+    Bku = ROTL64(A##sa ^ Da, 18); \
+    E##ka = Bka ^ (Bke | Bki); \
+    E##ke = Bke ^ (Bki & Bko); \
+    E##ki = Bki ^ (~Bko & Bku); \
+    E##ko = ~Bko ^ (Bku | Bka); \
+    E##ku = Bku ^ (Bka & Bke); \
+    Ca ^= E##ka; Ce ^= E##ke; Ci ^= E##ki; Co ^= E##ko; Cu ^= E##ku; \
+    \
+    Bma = ROTL64(A##bu ^ Du, 27); \
+    Bme = ROTL64(A##ga ^ Da, 36); \
+    Bmi = ROTL64(A##ke ^ De, 10); \
+    Bmo = ROTL64(A##mi ^ Di, 15); \
+    Bmu = ROTL64(A##so ^ Do, 56); \
+    E##ma = Bma ^ (Bme & Bmi); \
+    E##me = Bme ^ (Bmi | Bmo); \
+    E##mi = Bmi ^ (~Bmo | Bmu); \
+    E##mo = ~Bmo ^ (Bmu & Bma); \
+    E##mu = Bmu ^ (Bma | Bme); \
+    Ca ^= E##ma; Ce ^= E##me; Ci ^= E##mi; Co ^= E##mo; Cu ^= E##mu; \
+    \
+    Bsa = ROTL64(A##bi ^ Di, 62); \
+    Bse = ROTL64(A##go ^ Do, 55); \
+    Bsi = ROTL64(A##ku ^ Du, 39); \
+    Bso = ROTL64(A##ma ^ Da, 41); \
+    Bsu = ROTL64(A##se ^ De,  2); \
+    E##sa = Bsa ^ (~Bse & Bsi); \
+    E##se = ~Bse ^ (Bsi | Bso); \
+    E##si = Bsi ^ (Bso & Bsu); \
+    E##so = Bso ^ (Bsu | Bsa); \
+    E##su = Bsu ^ (Bsa & Bse); \
+    Ca ^= E##sa; Ce ^= E##se; Ci ^= E##si; Co ^= E##so; Cu ^= E##su
+
+// last round cut down to row 0 (lanes ba..bu, the first 40 bytes of the
+// output), for callers that read no more of the final state. what is left
+// of E after it is undefined apart from row 0.
+
+#define KECCAK_ROUND_ROW0(A, E, i) \
+    Da = Cu ^ ROTL64(Ce, 1); \
+    De = Ca ^ ROTL64(Ci, 1); \
+    Di = Ce ^ ROTL64(Co, 1); \
+    Do = Ci ^ ROTL64(Cu, 1); \
+    Du = Co ^ ROTL64(Ca, 1); \
+    \
+    Bba = A##ba ^ Da; \
+    Bbe = ROTL64(A##ge ^ De, 44); \
+    Bbi = ROTL64(A##ki ^ Di, 43); \
+    Bbo = ROTL64(A##mo ^ Do, 21); \
+    Bbu = ROTL64(A##su ^ Du, 14); \
+    E##ba = Bba ^ (Bbe | Bbi) ^ keccakp_rndc[i]; \
+    E##be = Bbe ^ (~Bbi | Bbo); \
+    E##bi = Bbi ^ (Bbo & Bbu); \
+    E##bo = Bbo ^ (Bbu | Bba); \
+    E##bu = Bbu ^ (Bba & Bbe)
+
+// rounds r0..23 of Keccak-p[1600] on state A (E and B are scratch); r0 = 0
+// is the full Keccak-f. the entry switch folds away for a constant r0, and
+// there is never a per-round branch. the _LAST form runs round 23 with
+// LAST, e.g. KECCAK_ROUND_ROW0, for any r0 < 23.
+
+#define KECCAK_ROUNDS_FROM_LAST(r0, LAST) \
+    KECCAK_PARITY(A); \
+    if ((r0) & 1) {                         /* realign to an even round */ \
+        KECCAK_ROUND(A, E, (r0)); \
+        KECCAK_COPY(A, E); \
+    } \
+    switch (((r0) + 1) & ~1) { \
+        case 0:  KECCAK_ROUND(A, E,  0); KECCAK_ROUND(E, A,  1); /* FALLTHRU */ \
+        case 2:  KECCAK_ROUND(A, E,  2); KECCAK_ROUND(E, A,  3); /* FALLTHRU */ \
+        case 4:  KECCAK_ROUND(A, E,  4); KECCAK_ROUND(E, A,  5); /* FALLTHRU */ \
+        case 6:  KECCAK_ROUND(A, E,  6); KECCAK_ROUND(E, A,  7); /* FALLTHRU */ \
+        case 8:  KECCAK_ROUND(A, E,  8); KECCAK_ROUND(E, A,  9); /* FALLTHRU */ \
+        case 10: KECCAK_ROUND(A, E, 10); KECCAK_ROUND(E, A, 11); /* FALLTHRU */ \
+        case 12: KECCAK_ROUND(A, E, 12); KECCAK_ROUND(E, A, 13); /* FALLTHRU */ \
+        case 14: KECCAK_ROUND(A, E, 14); KECCAK_ROUND(E, A, 15); /* FALLTHRU */ \
+        case 16: KECCAK_ROUND(A, E, 16); KECCAK_ROUND(E, A, 17); /* FALLTHRU */ \
+        case 18: KECCAK_ROUND(A, E, 18); KECCAK_ROUND(E, A, 19); /* FALLTHRU */ \
+        case 20: KECCAK_ROUND(A, E, 20); KECCAK_ROUND(E, A, 21); /* FALLTHRU */ \
+        case 22: KECCAK_ROUND(A, E, 22); LAST(E, A, 23);         /* FALLTHRU */ \
+        default: break; \
+    }
+
+#define KECCAK_ROUNDS_FROM(r0) KECCAK_ROUNDS_FROM_LAST(r0, KECCAK_ROUND)
+
+#define KECCAK_LD_SCALAR(i)     SHA3_LE64(st[i])
+#define KECCAK_ST_SCALAR(i, v)  st[i] = SHA3_LE64(v)
+
+static inline void keccakp_unrolled(uint64_t st[25], int r0)
+{
+    KECCAK_DECLARE(A);
+    KECCAK_DECLARE(E);
+    KECCAK_DECLARE(B);
+    KECCAK_DECLARE_CD(uint64_t);
+
+    KECCAK_LOAD_F(A, KECCAK_LD_SCALAR);
+    KECCAK_ROUNDS_FROM(r0);
+    KECCAK_STORE_F(KECCAK_ST_SCALAR, A);
+}
+
+#endif
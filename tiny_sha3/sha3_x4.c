@@ -0,0 +1,41 @@
+// sha3_x4.c
+// 4-way interleaved Keccak-f[1600]. The unrolled rounds of the scalar
+// backend run on a GCC vector type holding the same lane of four states;
+// on x86 there is also an AVX2 build of the kernel.
+
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+typedef uint64_t sha3_v4 __attribute__((vector_size(32)));
+typedef uint64_t sha3_v4u __attribute__((vector_size(32), aligned(8)));
+
+#define KECCAK_LD_X4(i)     (*(const sha3_v4u *) &st[4 * (i)])
+#define KECCAK_ST_X4(i, v)  *(sha3_v4u *) &st[4 * (i)] = (v)
+
+static inline __attribute__((always_inline))
+void keccakp_x4(uint64_t st[4 * 25], int r0)
+{
+    KECCAK_DECLARE_T(sha3_v4, A);
+    KECCAK_DECLARE_T(sha3_v4, E);
+    KECCAK_DECLARE_T(sha3_v4, B);
+    KECCAK_DECLARE_CD(sha3_v4);
+
+    KECCAK_LOAD_F(A, KECCAK_LD_X4);
+    KECCAK_ROUNDS_FROM(r0);
+    KECCAK_STORE_F(KECCAK_ST_X4, A);
+}
+
+// portable build; the compiler splits the vectors to what the target has
+
+void sha3_keccakp_x4_generic(uint64_t st[4 * 25], int r0)
+{
+    keccakp_x4(st, r0);
+}
+
+#ifdef SHA3_X86
+__attribute__((target("avx2")))
+void sha3_keccakp_x4_avx2(uint64_t st[4 * 25], int r0)
+{
+    keccakp_x4(st, r0);
+}
+#endif
@@ -0,0 +1,51 @@
+// sha3_x8.c
+// 8-way interleaved Keccak-f[1600]: the unrolled rounds on a 512-bit GCC
+// vector type, one lane of the eight states per vector. With AVX-512F each
+// is one zmm register; without it the compiler splits them into AVX2 or
+// narrower halves.
+
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+typedef uint64_t sha3_v8 __attribute__((vector_size(64)));
+typedef uint64_t sha3_v8u __attribute__((vector_size(64), aligned(8)));
+
+#define KECCAK_LD_X8(i)     (*(const sha3_v8u *) &st[8 * (i)])
+#define KECCAK_ST_X8(i, v)  *(sha3_v8u *) &st[8 * (i)] = (v)
+
+static inline __attribute__((always_inline))
+void keccakp_x8(uint64_t st[8 * 25], int r0)
+{
+    KECCAK_DECLARE_T(sha3_v8, A);
+    KECCAK_DECLARE_T(sha3_v8, E);
+    KECCAK_DECLARE_T(sha3_v8, B);
+    KECCAK_DECLARE_CD(sha3_v8);
+
+    KECCAK_LOAD_F(A, KECCAK_LD_X8);
+    KECCAK_ROUNDS_FROM(r0);
+    KECCAK_STORE_F(KECCAK_ST_X8, A);
+}
+
+void sha3_keccakp_x8_generic(uint64_t st[8 * 25], int r0)
+{
+    keccakp_x8(st, r0);
+}
+
+#ifdef SHA3_X86
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+void sha3_keccakp_x8_avx2(uint64_t st[8 * 25], int r0)
+{
+    keccakp_x8(st, r0);
+}
+
+// the same unrolled rounds; with AVX-512F enabled the compiler turns the
+// rotations into vprolq and the three-input XORs and chi into vpternlogq
+
+__attribute__((target("avx512f")))
+void sha3_keccakp_x8_avx512(uint64_t st[8 * 25], int r0)
+{
+    keccakp_x8(st, r0);
+}
+#endif
@@ -0,0 +1,158 @@
+// sha3_xof.c
+// Bulk SHAKE output: several SHAKE instances squeezed side by side on the
+// multi-state kernels, and a seedable, forkable Keccak PRNG built on eight
+// parallel SHAKE128 streams.
+
+#include <string.h>
+#include "sha3_unrolled.h"
+#include "sha3_dispatch.h"
+
+// copy the first len bytes of the rate of state k out of the interleaved
+// (native) lanes
+
+static void xof_block(uint8_t *out, const uint64_t *v, int ways, int k,
+    size_t len)
+{
+    uint64_t t;
+    size_t i;
+
+    for (i = 0; i + 8 <= len; i += 8) {
+        t = SHA3_LE64(v[(i / 8) * ways + k]);
+        memcpy(out + i, &t, 8);
+    }
+    if (i < len) {
+        t = SHA3_LE64(v[(i / 8) * ways + k]);
+        memcpy(out + i, &t, len - i);
+    }
+}
+
+// squeeze len bytes from each of n SHAKE contexts (after shake_xof). the
+// contexts must share rate and position to run in parallel, otherwise
+// this is shake_out() on each
+
+void shake_out_multi(sha3_ctx_t *const c[], void *const out[], int n,
+    size_t len)
+{
+    uint64_t v[SHA3_MAX_WAYS * 25] __attribute__((aligned(64)));
+    sha3_ctx_t pad;
+    sha3_ctx_t *cw[SHA3_MAX_WAYS];
+    size_t m, done;
+    int k, ways, rsiz, same;
+
+    if (n <= 0)
+        return;
+
+    rsiz = c[0]->rsiz;
+    same = n <= SHA3_MAX_WAYS && (rsiz & 7) == 0;
+    for (k = 1; k < n && same; k++)
+        same = c[k]->rsiz == rsiz && c[k]->pt == c[0]->pt;
+    if (!same) {
+        for (k = 0; k < n; k++)
+            shake_out(c[k], out[k], len);
+        return;
+    }
+
+    // rest of the current block, one by one
+    m = 0;
+    if (c[0]->pt < rsiz) {
+        m = rsiz - c[0]->pt;
+        if (m > len)
+            m = len;
+        for (k = 0; k < n; k++)
+            shake_out(c[k], out[k], m);
+    }
+    if (m == len)
+        return;
+
+    // then whole blocks in parallel; unused lanes run on a dummy state
+    ways = n <= 4 ? 4 : 8;
+    memset(&pad, 0, sizeof(pad));
+    for (k = 0; k < ways; k++)
+        cw[k] = k < n ? c[k] : &pad;
+    sha3_interleave(v, cw, ways);
+
+    for (done = m; done < len; done += m) {
+        if (ways == 8)
+            sha3_impl.x8(v, 0);
+        else
+            sha3_impl.x4(v, 0);
+        m = len - done < (size_t) rsiz ? len - done : (size_t) rsiz;
+        for (k = 0; k < n; k++)
+            xof_block((uint8_t *) out[k] + done, v, ways, k, m);
+    }
+
+    sha3_deinterleave(cw, v, ways);
+    for (k = 0; k < n; k++)
+        c[k]->pt = m;
+}
+
+// Keccak PRNG. stream k is SHAKE128(seed || k); one output round is the
+// next rate block of streams 0..7 in order.
+
+#define PRNG_RATE   168
+
+void sha3_prng_init(sha3_prng_t *g, const void *seed, size_t len)
+{
+    sha3_ctx_t c[SHA3_MAX_WAYS];
+    sha3_ctx_t *cp[SHA3_MAX_WAYS];
+    uint8_t k;
+
+    for (k = 0; k < SHA3_MAX_WAYS; k++) {
+        shake128_init(&c[k]);
+        shake_update(&c[k], seed, len);
+        shake_update(&c[k], &k, 1);
+        shake_xof(&c[k]);
+        cp[k] = &c[k];
+    }
+    sha3_interleave(g->v, cp, SHA3_MAX_WAYS);
+    g->pos = sizeof(g->buf);
+}
+
+// one output round from the state, then advance it
+
+static void prng_round(sha3_prng_t *g, uint8_t *out)
+{
+    int k;
+
+    for (k = 0; k < SHA3_MAX_WAYS; k++)
+        xof_block(out + PRNG_RATE * k, g->v, SHA3_MAX_WAYS, k, PRNG_RATE);
+    sha3_impl.x8(g->v, 0);
+}
+
+void sha3_prng_fill(sha3_prng_t *g, void *buf, size_t n)
+{
+    uint8_t *p = (uint8_t *) buf;
+    size_t m;
+
+    // buffered bytes first
+    m = sizeof(g->buf) - g->pos;
+    if (m > n)
+        m = n;
+    memcpy(p, g->buf + g->pos, m);
+    g->pos += m;
+    p += m;
+    n -= m;
+
+    // whole rounds straight to the caller
+    while (n >= sizeof(g->buf)) {
+        prng_round(g, p);
+        p += sizeof(g->buf);
+        n -= sizeof(g->buf);
+    }
+
+    if (n > 0) {
+        prng_round(g, g->buf);
+        memcpy(p, g->buf, n);
+        g->pos = n;
+    }
+}
+
+// child seeded from 32 bytes of the parent's output
+
+void sha3_prng_fork(sha3_prng_t *child, sha3_prng_t *parent)
+{
+    uint8_t seed[32];
+
+    sha3_prng_fill(parent, seed, sizeof(seed));
+    sha3_prng_init(child, seed, sizeof(seed));
+}
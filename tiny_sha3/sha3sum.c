@@ -0,0 +1,451 @@
+// sha3sum.c
+// Print or check SHA3 checksums, in the format of coreutils sha256sum.
+// Files are hashed by a pool of threads: large files are mapped and hashed
+// one per worker, runs of small files are read whole and hashed together
+// on the multi-buffer path.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sha3.h"
+
+#define SUM_SMALL       (1 << 16)           // multi-buffer up to this size
+#define SUM_BATCH       32                  // small files per work item
+#define SUM_BATCHBYTES  (1 << 20)
+#define SUM_MAXTHREADS  256
+
+typedef struct {
+    const char *name;
+    off_t size;                             // -1: not a regular file
+    int mdlen;
+    int err;                                // errno, 0 if hashed
+    uint8_t md[64];
+    const char *expect;                     // --check: hex from the list
+} sum_file_t;
+
+typedef struct {
+    size_t first, n;                        // files[first .. first + n - 1]
+    size_t bytes;                           // buffer needed by a small run
+} sum_item_t;
+
+static sum_file_t *files;
+static sum_item_t *items;
+static size_t nitems, next_item;
+
+// one file by streaming reads (pipes, stdin, or when mmap fails), the
+// reads overlapped with the hashing
+
+static void sum_read(sum_file_t *f, int fd)
+{
+    sha3_ctx_t c;
+
+    sha3_init(&c, f->mdlen);
+    if (!sha3_stream_update(&c, fd, NULL)) {
+        f->err = errno;
+        return;
+    }
+    sha3_final(f->md, &c);
+}
+
+static void sum_large(sum_file_t *f)
+{
+    void *p;
+    int fd;
+
+    if (strcmp(f->name, "-") == 0) {
+        sum_read(f, 0);
+        return;
+    }
+    if ((fd = open(f->name, O_RDONLY)) < 0) {
+        f->err = errno;
+        return;
+    }
+    p = MAP_FAILED;
+    if (f->size > 0)
+        p = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+        madvise(p, f->size, MADV_SEQUENTIAL);
+        sha3(p, f->size, f->md, f->mdlen);
+        munmap(p, f->size);
+    } else {
+        sum_read(f, fd);
+    }
+    close(fd);
+}
+
+// read until len bytes or end of file; a read may return less
+
+static ssize_t sum_readall(int fd, uint8_t *buf, size_t len)
+{
+    size_t n;
+    ssize_t r;
+
+    r = 0;
+    for (n = 0; n < len; n += r) {
+        r = read(fd, buf + n, len - n);
+        if (r < 0 && errno == EINTR)
+            r = 0;
+        else if (r <= 0)
+            break;
+    }
+
+    return r < 0 ? -1 : (ssize_t) n;
+}
+
+// a run of small regular files of the same digest size: read them all
+// into buf, hash them as one batch. one byte more than the size is asked
+// for, so a file that grew is caught and hashed on its own.
+
+static void sum_small(sum_file_t *f, size_t n, uint8_t *buf)
+{
+    sha3_job_t job[SUM_BATCH];
+    size_t i, m, off;
+    ssize_t r;
+    int fd;
+
+    m = 0;
+    off = 0;
+    for (i = 0; i < n; i++) {
+        if ((fd = open(f[i].name, O_RDONLY)) < 0) {
+            f[i].err = errno;
+            continue;
+        }
+        r = sum_readall(fd, buf + off, f[i].size + 1);
+        close(fd);
+        if (r != f[i].size) {                   // changed or unreadable
+            f[i].err = 0;
+            sum_large(&f[i]);
+            continue;
+        }
+        job[m].in = buf + off;
+        job[m].inlen = r;
+        job[m].md = f[i].md;
+        m++;
+        off += r;
+    }
+    sha3_batch(job, m, f[0].mdlen);
+}
+
+static int sum_is_small(const sum_file_t *f)
+{
+    return f->size >= 0 && f->size <= SUM_SMALL;
+}
+
+static void *sum_worker(void *arg)
+{
+    uint8_t *buf;
+    size_t i;
+
+    (void) arg;
+    buf = (uint8_t *) malloc(SUM_BATCHBYTES);
+    while ((i = __atomic_fetch_add(&next_item, 1, __ATOMIC_RELAXED)) <
+        nitems) {
+        if (buf != NULL && sum_is_small(&files[items[i].first]))
+            sum_small(&files[items[i].first], items[i].n, buf);
+        else
+            sum_large(&files[items[i].first]);
+    }
+    free(buf);
+
+    return NULL;
+}
+
+// stat the files, group small ones, run the pool
+
+static void sum_run(size_t nfiles, int nthreads)
+{
+    pthread_t tid[SUM_MAXTHREADS];
+    struct stat sb;
+    sum_item_t *it;
+    size_t i;
+    int t, started;
+
+    if (nfiles == 0)                        // malloc(0) may be NULL
+        return;
+    items = (sum_item_t *) malloc(nfiles * sizeof(sum_item_t));
+    if (items == NULL) {
+        perror("sha3sum");
+        exit(1);
+    }
+
+    nitems = 0;
+    for (i = 0; i < nfiles; i++) {
+        files[i].size = -1;
+        if (strcmp(files[i].name, "-") == 0) {
+            sum_large(&files[i]);           // stdin, here and now
+            continue;
+        }
+        if (stat(files[i].name, &sb) == 0 && S_ISREG(sb.st_mode))
+            files[i].size = sb.st_size;
+
+        // extend the previous run of small files if this one fits
+        it = nitems > 0 ? &items[nitems - 1] : NULL;
+        if (it != NULL && sum_is_small(&files[i]) &&
+            sum_is_small(&files[it->first]) && it->first + it->n == i &&
+            files[it->first].mdlen == files[i].mdlen && it->n < SUM_BATCH &&
+            it->bytes + files[i].size + 1 <= SUM_BATCHBYTES) {
+            it->n++;
+            it->bytes += files[i].size + 1;
+            continue;
+        }
+        items[nitems].first = i;
+        items[nitems].n = 1;
+        items[nitems].bytes = files[i].size + 1;
+        nitems++;
+    }
+
+    if (nthreads <= 0)
+        nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > SUM_MAXTHREADS)
+        nthreads = SUM_MAXTHREADS;
+    if ((size_t) nthreads > nitems)
+        nthreads = (int) nitems;
+
+    next_item = 0;
+    started = 0;
+    for (t = 1; t < nthreads; t++) {
+        if (pthread_create(&tid[t], NULL, sum_worker, NULL) != 0)
+            break;
+        started++;
+    }
+    sum_worker(NULL);
+    for (t = 1; t <= started; t++)
+        pthread_join(tid[t], NULL);
+
+    free(items);
+}
+
+static void sum_hex(char *s, const uint8_t *md, int mdlen)
+{
+    int i;
+
+    for (i = 0; i < mdlen; i++)
+        sprintf(s + 2 * i, "%02x", md[i]);
+}
+
+// coreutils escaping: in a name with a backslash, newline or carriage
+// return those are written as \\, \n and \r, and the line gets a leading
+// backslash
+
+static int sum_escaped(const char *name)
+{
+    return strpbrk(name, "\\\n\r") != NULL;
+}
+
+static void sum_name(const char *name)
+{
+    for (; *name != 0; name++) {
+        if (*name == '\\')
+            fputs("\\\\", stdout);
+        else if (*name == '\n')
+            fputs("\\n", stdout);
+        else if (*name == '\r')
+            fputs("\\r", stdout);
+        else
+            putchar(*name);
+    }
+}
+
+// undo it in place; 0 for an unknown escape
+
+static int sum_unescape(char *s)
+{
+    char *d;
+
+    for (d = s; *s != 0; s++) {
+        if (*s != '\\') {
+            *d++ = *s;
+            continue;
+        }
+        s++;
+        if (*s == '\\')
+            *d++ = '\\';
+        else if (*s == 'n')
+            *d++ = '\n';
+        else if (*s == 'r')
+            *d++ = '\r';
+        else
+            return 0;
+    }
+    *d = 0;
+
+    return 1;
+}
+
+// "hex  name" or "hex *name" lines, escaped ones with a leading backslash;
+// the digest size follows from the hex
+
+static size_t sum_parse(FILE *fp, const char *list, size_t nfiles,
+    size_t *cap)
+{
+    char *line, *p, *name;
+    size_t n, len, ln;
+    int esc;
+
+    line = NULL;
+    len = 0;
+    ln = 0;
+    while (getline(&line, &len, fp) > 0) {
+        ln++;
+        p = line + strcspn(line, "\r\n");
+        *p = 0;
+        esc = line[0] == '\\';
+        p = line + esc;
+        n = strspn(p, "0123456789abcdefABCDEF");
+        name = p + n + 2;
+        if ((n != 56 && n != 64 && n != 96 && n != 128) ||
+            p[n] != ' ' || (p[n + 1] != ' ' && p[n + 1] != '*') ||
+            *name == 0 || (esc && !sum_unescape(name))) {
+            if (line[0] != 0)
+                fprintf(stderr, "sha3sum: %s: %d: improperly formatted "
+                    "SHA3 checksum line\n", list, (int) ln);
+            continue;
+        }
+        if (nfiles == *cap) {
+            *cap = 2 * *cap + 16;
+            files = (sum_file_t *) realloc(files, *cap * sizeof(sum_file_t));
+            if (files == NULL) {
+                perror("sha3sum");
+                exit(1);
+            }
+        }
+        memset(&files[nfiles], 0, sizeof(sum_file_t));
+        p[n] = 0;
+        files[nfiles].expect = strdup(p);
+        files[nfiles].name = strdup(name);
+        files[nfiles].mdlen = n / 2;
+        nfiles++;
+    }
+    free(line);
+
+    return nfiles;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: sha3sum [-a 224|256|384|512] [-j threads] [-c] [file...]\n"
+        "Print or check SHA3 checksums. With no file, or when file is -,\n"
+        "read standard input. -c, --check reads checksum lists and\n"
+        "verifies them.\n");
+    exit(1);
+}
+
+static const struct option sum_long[] = {
+    { "check", no_argument, NULL, 'c' },
+    { NULL, 0, NULL, 0 }
+};
+
+int main(int argc, char **argv)
+{
+    char hex[129];
+    size_t i, nfiles, cap;
+    int opt, bits, nthreads, check, bad, failed, esc;
+    FILE *fp;
+
+    bits = 256;
+    nthreads = 0;
+    check = 0;
+    while ((opt = getopt_long(argc, argv, "a:j:c", sum_long, NULL)) != -1) {
+        switch (opt) {
+            case 'a':
+                bits = atoi(optarg);
+                if (bits != 224 && bits != 256 && bits != 384 && bits != 512)
+                    usage();
+                break;
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+            case 'c':
+                check = 1;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    files = NULL;
+    nfiles = 0;
+    cap = 0;
+    if (check && optind == argc) {
+        nfiles = sum_parse(stdin, "-", 0, &cap);
+    } else if (check) {
+        for (i = optind; i < (size_t) argc; i++) {
+            fp = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "r");
+            if (fp == NULL) {
+                fprintf(stderr, "sha3sum: %s: %s\n", argv[i],
+                    strerror(errno));
+                return 1;
+            }
+            nfiles = sum_parse(fp, argv[i], nfiles, &cap);
+            if (fp != stdin)
+                fclose(fp);
+        }
+    } else {
+        nfiles = argc > optind ? (size_t) (argc - optind) : 1;
+        files = (sum_file_t *) calloc(nfiles, sizeof(sum_file_t));
+        if (files == NULL) {
+            perror("sha3sum");
+            return 1;
+        }
+        for (i = 0; i < nfiles; i++) {
+            files[i].name = argc > optind ? argv[optind + i] : "-";
+            files[i].mdlen = bits / 8;
+        }
+    }
+
+    if (check && nfiles == 0) {
+        fprintf(stderr, "sha3sum: no properly formatted SHA3 checksum lines "
+            "found\n");
+        return 1;
+    }
+    sum_run(nfiles, nthreads);
+
+    bad = 0;
+    failed = 0;
+    for (i = 0; i < nfiles; i++) {
+        esc = sum_escaped(files[i].name);
+        if (files[i].err != 0) {
+            fprintf(stderr, "sha3sum: %s: %s\n", files[i].name,
+                strerror(files[i].err));
+            if (check) {
+                fputs(esc ? "\\" : "", stdout);
+                sum_name(files[i].name);
+                printf(": FAILED open or read\n");
+            }
+            bad++;
+            continue;
+        }
+        sum_hex(hex, files[i].md, files[i].mdlen);
+        fputs(esc ? "\\" : "", stdout);
+        if (!check) {
+            printf("%s  ", hex);
+            sum_name(files[i].name);
+            putchar('\n');
+        } else if (strcasecmp(hex, files[i].expect) == 0) {
+            sum_name(files[i].name);
+            printf(": OK\n");
+        } else {
+            sum_name(files[i].name);
+            printf(": FAILED\n");
+            failed++;
+        }
+    }
+
+    if (bad > 0 && check)
+        fprintf(stderr, "sha3sum: WARNING: %d listed file%s could not be "
+            "read\n", bad, bad > 1 ? "s" : "");
+    if (failed > 0)
+        fprintf(stderr, "sha3sum: WARNING: %d computed checksum%s did NOT "
+            "match\n", failed, failed > 1 ? "s" : "");
+
+    return bad > 0 || failed > 0;
+}